@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace detail {
+
+    // english translations and queries are matched by their normalized key:
+    // ascii letters in lower case, notes in parentheses like "(to)" removed,
+    // apostrophes dropped and any other ascii punctuation or white space
+    // turned into single spaces between the words, e.g.
+    //   "(to) Eat; Drink!" -> "eat drink"
+    // utf-8 sequences are kept as they are
+
+    // append version reuses the capacity of 'out'
+    void appendNormalizedEnglish(std::string_view english, std::string& out);
+    [[nodiscard]] bool isNormalizedEnglish(std::string_view english);
+
+    // the key of 'english', 'english' itself if it is one already,
+    // otherwise it is written to 'buffer', which has to outlive the result
+    [[nodiscard]] std::string_view normalizeEnglish(std::string_view english,
+                                                    std::string& buffer);
+
+} // namespace detail
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace detail {
+
+    // bounded least recently used cache of translation results, split into
+    // shards with a lock each, so lookups of different queries rarely wait
+    // for each other
+    //
+    // every shard remembers the generation (e.g. the store size) its
+    // entries were computed for, a lookup with another generation drops
+    // all of them
+    struct QueryCache {
+        enum class Kind : uint8_t {
+            Kana,
+            English,
+            Kanji,
+            SimilarKana,
+            SimilarEnglish
+        };
+
+        struct Key {
+            Kind kind;
+            // limit respectively maximum distance of the query
+            uint32_t parameter;
+            std::string_view query;
+
+            bool operator==(const Key& rhs) const {
+                return this->kind == rhs.kind &&
+                       this->parameter == rhs.parameter &&
+                       this->query == rhs.query;
+            }
+        };
+
+        static constexpr const size_t ShardCount = 8;
+
+        explicit QueryCache(size_t capacity = 1024);
+        QueryCache(const QueryCache&) = delete;
+        QueryCache& operator=(const QueryCache&) = delete;
+
+        std::optional<std::wstring> find(const Key& key, uint64_t generation);
+        void insert(const Key& key, std::wstring value, uint64_t generation);
+
+        // cached result or the one of 'compute', which is called
+        // without holding a lock
+        template <typename _Compute>
+        std::wstring get(const Key& key, uint64_t generation,
+                         _Compute&& compute) {
+            if (auto cached = this->find(key, generation))
+                return std::move(*cached);
+
+            auto value = compute();
+            this->insert(key, value, generation);
+            return value;
+        }
+
+        void clear();
+
+        size_t size() const;
+        uint64_t hits() const {
+            return this->m_Hits.load(std::memory_order_relaxed);
+        }
+        uint64_t misses() const {
+            return this->m_Misses.load(std::memory_order_relaxed);
+        }
+
+      private:
+        struct KeyHash {
+            size_t operator()(const Key& key) const;
+        };
+
+        struct Entry {
+            Kind kind;
+            uint32_t parameter;
+            std::string query;
+            std::wstring value;
+
+            // references 'query', list nodes never move
+            Key key() const {
+                return {this->kind, this->parameter, this->query};
+            }
+        };
+
+        struct Shard {
+            mutable std::mutex mutex;
+            uint64_t generation = 0;
+            // most recently used first
+            std::list<Entry> entries;
+            std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+
+            void clear() {
+                this->index.clear();
+                this->entries.clear();
+            }
+        };
+
+        Shard& _shard(const Key& key);
+
+        const size_t m_ShardCapacity;
+        std::array<Shard, ShardCount> m_Shards;
+        std::atomic<uint64_t> m_Hits = 0;
+        std::atomic<uint64_t> m_Misses = 0;
+    };
+
+} // namespace detail
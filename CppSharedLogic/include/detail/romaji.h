@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace detail {
+
+    // hepburn romaji <-> kana transliteration, both directions are longest
+    // match automatons generated at compile time from one table
+    //
+    // kana -> romaji:
+    //   - hiragana and katakana, yoon (きゃ -> kya) and the katakana
+    //     extensions (ティ -> ti, ファ -> fa)
+    //   - sokuon doubles the next consonant (きって -> kitte,
+    //     まっちゃ -> matcha)
+    //   - ん before a vowel or y is written n' (しんよう -> shin'you)
+    //   - ー repeats the previous vowel (ラーメン -> raamen)
+    //
+    // romaji -> kana additionally accepts the common ime spellings
+    // (si, tu, hu, ...), nn for ん (but nn + vowel is ん + な, に, ...),
+    // small kana with a leading x or l, '-' as ー and macron vowels
+    // (ō -> おう, in katakana ー)
+    //
+    // everything which can not be converted is copied unchanged,
+    // all text is utf-8
+
+    enum class KanaScript { Hiragana, Katakana };
+
+    void appendKanaToRomaji(std::string_view kana, std::string& out);
+    void appendRomajiToKana(std::string_view romaji, std::string& out,
+                            KanaScript script = KanaScript::Hiragana);
+
+    [[nodiscard]] std::string convertKanaToRomaji(std::string_view kana);
+    [[nodiscard]] std::string
+        convertRomajiToKana(std::string_view romaji,
+                            KanaScript script = KanaScript::Hiragana);
+
+    // batch versions, all results are written into one buffer,
+    // result i is out[offsets[i] .. offsets[i + 1]]
+    void convertKanaToRomaji(const std::vector<std::string_view>& kana,
+                             std::string& out, std::vector<uint32_t>& offsets);
+    void convertRomajiToKana(const std::vector<std::string_view>& romaji,
+                             std::string& out, std::vector<uint32_t>& offsets,
+                             KanaScript script = KanaScript::Hiragana);
+
+    // only latin letters, macron vowels, apostrophes, hyphens and spaces,
+    // with at least one letter
+    [[nodiscard]] bool isRomaji(std::string_view text);
+
+} // namespace detail
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace detail::util {
+
+    // fixed number of worker threads, tasks are started in submission order
+    struct ThreadPool {
+        explicit ThreadPool(size_t threadCount = DefaultThreadCount());
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // finishes all already submitted tasks
+        ~ThreadPool();
+
+        static size_t DefaultThreadCount();
+        size_t size() const;
+
+        template <typename _Function>
+        std::future<std::invoke_result_t<std::decay_t<_Function>>>
+            submit(_Function&& function) {
+            using ResultType = std::invoke_result_t<std::decay_t<_Function>>;
+            auto task = std::make_shared<std::packaged_task<ResultType()>>(
+                std::forward<_Function>(function));
+
+            auto future = task->get_future();
+            {
+                std::lock_guard lock(this->m_Mutex);
+                this->m_Tasks.emplace([task]() { (*task)(); });
+            }
+            this->m_Condition.notify_one();
+            return future;
+        }
+
+      private:
+        void _run();
+
+        bool m_Stop = false;
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::queue<std::function<void()>> m_Tasks;
+        std::vector<std::thread> m_Threads;
+    };
+
+} // namespace detail::util
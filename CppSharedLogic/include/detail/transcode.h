@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace detail {
+
+    // utf-8 <-> wide string conversion, wide strings are utf-32
+    // (utf-16 on platforms with a 16 bit wchar_t)
+    //
+    // all functions are reentrant and may be called from any thread,
+    // invalid input is replaced by U+FFFD instead of throwing
+
+    // append versions reuse the capacity of 'out'
+    void appendUtf8ToWstring(std::string_view utf8, std::wstring& out);
+    void appendWstringToUtf8(std::wstring_view wide, std::string& out);
+
+    [[nodiscard]] std::wstring convertUtf8Wstring(std::string_view str);
+    [[nodiscard]] std::string convertWstringUtf8(std::wstring_view str);
+
+    // single code point access for code working on utf-8 directly,
+    // 'pos' is advanced behind the decoded sequence
+    [[nodiscard]] char32_t nextUtf8CodePoint(std::string_view utf8,
+                                             size_t& pos);
+    void appendUtf8CodePoint(char32_t cp, std::string& out);
+
+} // namespace detail
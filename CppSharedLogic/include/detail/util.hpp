@@ -2,8 +2,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <random>
+#include <string>
 #include <string_view>
 
 #include <sqlite3.h>
@@ -48,10 +50,10 @@ namespace detail::util {
     }
 
     template <typename _Container>
-    std::wstring
-        combineWStringContainerToWstring(const _Container& container,
-                                         std::wstring_view separator = L"; ") {
-        std::wstring res;
+    std::string
+        combineStringContainerToString(const _Container& container,
+                                       std::string_view separator = "; ") {
+        std::string res;
         if (container.empty())
             return res;
 
@@ -64,10 +66,44 @@ namespace detail::util {
         return res;
     }
 
+    constexpr uint64_t fnv1a(const void* data, size_t size,
+                             uint64_t hash = 14695981039346656037ull) {
+        const auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // read only memory mapping of a whole file
+    struct MemoryMappedFile {
+        MemoryMappedFile(const std::string& filepath);
+        MemoryMappedFile(const MemoryMappedFile&) = delete;
+        MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+        ~MemoryMappedFile();
+
+        operator bool() const { return this->m_Data != nullptr; }
+        const char* data() const { return this->m_Data; }
+        size_t size() const { return this->m_Size; }
+        std::string_view view() const { return {this->m_Data, this->m_Size}; }
+
+        // hint that the file is read front to back only once,
+        // already read pages may be dropped early
+        void adviseSequential() const;
+
+      private:
+        const char* m_Data = nullptr;
+        size_t m_Size = 0;
+    };
+
     struct Sqlite3OpenCloseHelper {
-        Sqlite3OpenCloseHelper(std::string_view filepath) {
+        Sqlite3OpenCloseHelper(std::string_view filepath,
+                               int flags = SQLITE_OPEN_READWRITE |
+                                           SQLITE_OPEN_CREATE) {
             sqlite3* ptr = nullptr;
-            const auto res = sqlite3_open(filepath.data(), &ptr);
+            const auto res =
+                sqlite3_open_v2(filepath.data(), &ptr, flags, nullptr);
             this->m_Db.reset(ptr);
             if (res != SQLITE_OK)
                 this->m_Db = nullptr;
@@ -88,4 +124,80 @@ namespace detail::util {
         std::unique_ptr<sqlite3, Deleter> m_Db;
     };
 
+    struct Sqlite3StatementHelper {
+        Sqlite3StatementHelper(sqlite3* db, std::string_view sql) {
+            sqlite3_stmt* ptr = nullptr;
+            const auto res = sqlite3_prepare_v2(db, sql.data(), int(sql.size()),
+                                                &ptr, nullptr);
+            this->m_Stmt.reset(ptr);
+            if (res != SQLITE_OK)
+                this->m_Stmt = nullptr;
+        }
+
+        operator bool() const { return bool(this->m_Stmt); }
+        operator sqlite3_stmt*() { return this->m_Stmt.get(); }
+
+      private:
+        struct Deleter {
+            void operator()(sqlite3_stmt* toDelete) const {
+                (void)sqlite3_finalize(toDelete);
+            }
+        };
+        std::unique_ptr<sqlite3_stmt, Deleter> m_Stmt;
+    };
+
+    // rolled back on destruction unless it has been committed, so an
+    // early return never leaves a half written database behind
+    struct Sqlite3TransactionHelper {
+        explicit Sqlite3TransactionHelper(sqlite3* db) : m_Db(db) {
+            this->m_Active = sqlite3_exec(db, "begin immediate", nullptr,
+                                          nullptr, nullptr) == SQLITE_OK;
+        }
+        Sqlite3TransactionHelper(const Sqlite3TransactionHelper&) = delete;
+        Sqlite3TransactionHelper&
+            operator=(const Sqlite3TransactionHelper&) = delete;
+
+        ~Sqlite3TransactionHelper() {
+            if (this->m_Active)
+                (void)sqlite3_exec(this->m_Db, "rollback", nullptr, nullptr,
+                                   nullptr);
+        }
+
+        operator bool() const { return this->m_Active; }
+
+        bool commit() {
+            if (!this->m_Active ||
+                sqlite3_exec(this->m_Db, "commit", nullptr, nullptr,
+                             nullptr) != SQLITE_OK) {
+                return false;
+            }
+            this->m_Active = false;
+            return true;
+        }
+
+      private:
+        sqlite3* m_Db;
+        bool m_Active = false;
+    };
+
+    // sqlite uri of a file path, special uri characters are escaped
+    inline std::string sqlite3FileUri(std::string_view filepath,
+                                      std::string_view parameters = "") {
+        std::string uri = "file:";
+        for (const auto c : filepath) {
+            if (c == '%' || c == '?' || c == '#') {
+                constexpr const char* hex = "0123456789ABCDEF";
+                uri += '%';
+                uri += hex[(unsigned char)c >> 4];
+                uri += hex[(unsigned char)c & 0xF];
+            } else
+                uri += c;
+        }
+        if (!parameters.empty()) {
+            uri += '?';
+            uri += parameters;
+        }
+        return uri;
+    }
+
 } // namespace detail::util
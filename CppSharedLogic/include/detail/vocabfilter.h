@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "detail/vocabstore.h"
+
+namespace detail {
+
+    // set of vocabulary ids of a store, one bit per id
+    //
+    // a plain word array, even for jmdict (~200k ids) a bitmap is only
+    // 25kb and every operation works on 64 ids at once
+    struct VocabularyBitmap {
+        using word_type = uint64_t;
+        static constexpr const size_t WordBits = 64;
+
+        VocabularyBitmap() = default;
+        explicit VocabularyBitmap(size_t size);
+
+        // number of ids covered, not the number of set ones
+        size_t size() const { return this->m_Size; }
+        size_t count() const;
+
+        bool test(VocabularyId id) const;
+        void set(VocabularyId id);
+        void reset(VocabularyId id);
+        // sets [begin, end)
+        void set(VocabularyId begin, VocabularyId end);
+
+        const std::vector<word_type>& words() const { return this->m_Words; }
+        // 0 past the end
+        word_type word(size_t wordIdx) const {
+            return wordIdx < this->m_Words.size() ? this->m_Words[wordIdx] : 0;
+        }
+
+      private:
+        friend struct VocabularyQuery;
+
+        size_t m_Size = 0;
+        std::vector<word_type> m_Words;
+    };
+
+    // and / or / not combination of bitmaps, e.g.
+    //   using Q = VocabularyQuery;
+    //   (Q(attributes.level(N5)) | Q(attributes.level(N4))) & ~Q(deckBitmap)
+    //
+    // nothing is computed up front, iterating evaluates a block of words
+    // at a time and yields the ascending ids of its set bits, so taking
+    // only the first few matches never looks at the rest of the bitmaps
+    //
+    // a query references its bitmaps, they have to outlive it
+    struct VocabularyQuery {
+      private:
+        static constexpr const size_t BlockWords = 8;
+        using Block = std::array<VocabularyBitmap::word_type, BlockWords>;
+
+      public:
+        struct const_iterator {
+            using iterator_category = std::input_iterator_tag;
+            using value_type = VocabularyId;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const VocabularyId*;
+            using reference = VocabularyId;
+
+            // end iterator
+            const_iterator() = default;
+            explicit const_iterator(const VocabularyQuery* query);
+
+            reference operator*() const { return this->m_Id; }
+            pointer operator->() const { return &this->m_Id; }
+
+            const_iterator& operator++() {
+                this->_next();
+                return *this;
+            }
+            const_iterator operator++(int) {
+                auto tmp = *this;
+                this->_next();
+                return tmp;
+            }
+
+            bool operator==(const const_iterator& rhs) const {
+                return this->m_Query == rhs.m_Query && this->m_Id == rhs.m_Id;
+            }
+            bool operator!=(const const_iterator& rhs) const {
+                return !(*this == rhs);
+            }
+
+          private:
+            // moves to the next set bit, the end if there is none
+            void _next();
+
+            const VocabularyQuery* m_Query = nullptr;
+            Block m_Block{};
+            size_t m_FirstWord = 0;
+            size_t m_WordIdx = 0;
+            VocabularyBitmap::word_type m_Bits = 0;
+            VocabularyId m_Id = 0;
+        };
+
+        // only the address of 'bitmap' is kept, temporaries would dangle
+        explicit VocabularyQuery(const VocabularyBitmap& bitmap);
+        VocabularyQuery(const VocabularyBitmap&& bitmap) = delete;
+
+        friend VocabularyQuery operator&(const VocabularyQuery& lhs,
+                                         const VocabularyQuery& rhs);
+        friend VocabularyQuery operator|(const VocabularyQuery& lhs,
+                                         const VocabularyQuery& rhs);
+        friend VocabularyQuery operator~(const VocabularyQuery& query);
+
+        // largest size of all bitmaps involved, missing
+        // bits of smaller ones are treated as not set
+        size_t size() const { return this->m_Root->size; }
+        size_t count() const;
+        [[nodiscard]] VocabularyBitmap evaluate() const;
+
+        const_iterator begin() const { return const_iterator(this); }
+        const_iterator end() const { return const_iterator(); }
+
+      private:
+        enum class Operation { Bitmap, And, Or, Not };
+        struct Node {
+            Operation operation;
+            size_t size;
+            const VocabularyBitmap* bitmap;
+            std::shared_ptr<const Node> lhs, rhs;
+        };
+        explicit VocabularyQuery(std::shared_ptr<const Node> root)
+            : m_Root(std::move(root)) {}
+        static VocabularyQuery _combine(Operation operation,
+                                        const VocabularyQuery& lhs,
+                                        const VocabularyQuery* rhs);
+
+        // words [firstWord, firstWord + BlockWords) of 'node'
+        static void _evaluate(const Node& node, size_t firstWord, Block& out);
+        // same for the whole query, bits past size() are cleared
+        void _evaluate(size_t firstWord, Block& out) const;
+
+        // shared, copies of a query are cheap
+        std::shared_ptr<const Node> m_Root;
+    };
+
+    VocabularyQuery operator&(const VocabularyQuery& lhs,
+                              const VocabularyQuery& rhs);
+    VocabularyQuery operator|(const VocabularyQuery& lhs,
+                              const VocabularyQuery& rhs);
+    VocabularyQuery operator~(const VocabularyQuery& query);
+
+    // attribute bitmaps of all vocabulary of a store at the time of
+    // construction, later appended segments are not covered
+    struct VocabularyAttributes {
+        explicit VocabularyAttributes(const VocabularyStore& store);
+
+        size_t size() const { return this->m_HasKanji.size(); }
+
+        // taken from the type ranges of the segments
+        const VocabularyBitmap& level(Vocabulary::Type type) const {
+            return this->m_Levels[size_t(type)];
+        }
+        // kanji spelling with at least one kanji, see KanjiIndex::isKanji
+        const VocabularyBitmap& hasKanji() const { return this->m_HasKanji; }
+        // kana reading written in katakana only, mostly loan words
+        const VocabularyBitmap& katakanaOnly() const {
+            return this->m_KatakanaOnly;
+        }
+
+      private:
+        std::array<VocabularyBitmap, VocabularySegment::TypeCount> m_Levels;
+        VocabularyBitmap m_HasKanji;
+        VocabularyBitmap m_KatakanaOnly;
+    };
+
+} // namespace detail
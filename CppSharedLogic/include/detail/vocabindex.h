@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "detail/vocabsegment.h"
+
+namespace detail {
+
+    // inverted index of the english translations of one segment:
+    // space separated token -> ascending ids (within the segment) of all
+    // vocabulary having the token in at least one translation
+    //
+    // tokens reference the character arena of the segment, the index is
+    // valid as long as the segment data is alive
+    struct EnglishTokenIndex {
+        using Postings = std::pair<const VocabularyId*, const VocabularyId*>;
+
+        EnglishTokenIndex() = default;
+        explicit EnglishTokenIndex(const VocabularySegment& segment);
+
+        // empty range if the token is unknown
+        Postings find(std::string_view token) const;
+
+        // ids of all vocabulary containing every token of 'english',
+        // candidates still have to be checked for the exact word order
+        std::vector<VocabularyId> intersect(std::string_view english) const;
+
+        size_t tokenCount() const { return this->m_Tokens.size(); }
+
+        // calls 'function' for every non empty space separated token
+        template <typename _Function>
+        static void forEachToken(std::string_view text, _Function&& function) {
+            while (!text.empty()) {
+                const auto pos = text.find(' ');
+                if (pos != 0)
+                    function(text.substr(0, pos));
+                if (pos == std::string_view::npos)
+                    break;
+                text.remove_prefix(pos + 1);
+            }
+        }
+
+      private:
+        // unique tokens sorted, postings of token i are
+        // m_Postings[m_PostingBegin[i] .. m_PostingBegin[i + 1]]
+        std::vector<std::string_view> m_Tokens;
+        std::vector<uint32_t> m_PostingBegin;
+        std::vector<VocabularyId> m_Postings;
+    };
+
+    // inverted index of the kanji spellings of one segment:
+    // cjk ideograph -> ascending ids (within the segment) of all
+    // vocabulary using it at least once
+    struct KanjiIndex {
+        using Postings = std::pair<const VocabularyId*, const VocabularyId*>;
+
+        KanjiIndex() = default;
+        explicit KanjiIndex(const VocabularySegment& segment);
+
+        // empty range if no vocabulary uses 'kanji'
+        Postings find(char32_t kanji) const;
+
+        // ascending ids of all vocabulary using every kanji of 'kanji',
+        // other characters are ignored, empty if there is no kanji at all
+        std::vector<VocabularyId> intersect(std::string_view kanji) const;
+
+        size_t kanjiCount() const { return this->m_Kanji.size(); }
+
+        // cjk unified ideographs (including extension a and the
+        // compatibility block) and the iteration mark 々
+        static bool isKanji(char32_t cp) {
+            return (cp >= 0x4E00 && cp <= 0x9FFF) ||
+                   (cp >= 0x3400 && cp <= 0x4DBF) ||
+                   (cp >= 0xF900 && cp <= 0xFAFF) || cp == 0x3005;
+        }
+
+      private:
+        // sorted, postings of kanji i are
+        // m_Postings[m_PostingBegin[i] .. m_PostingBegin[i + 1]]
+        std::vector<char32_t> m_Kanji;
+        std::vector<uint32_t> m_PostingBegin;
+        std::vector<VocabularyId> m_Postings;
+    };
+
+    // suffix array over the kana readings of one segment, every suffix
+    // starting at a character boundary is listed once, sorted by its text
+    //
+    // all readings containing a string are one continuous range of
+    // suffixes starting with it, found by binary search
+    struct KanaSubstringIndex {
+        KanaSubstringIndex() = default;
+        explicit KanaSubstringIndex(VocabularySegment segment);
+
+        // ascending ids (within the segment) of all vocabulary whose kana
+        // contains 'kana', only the smallest 'limit' of them,
+        // 'kana' must not be empty
+        std::vector<VocabularyId> find(std::string_view kana,
+                                       size_t limit = NoLimit) const;
+
+        size_t suffixCount() const { return this->m_Suffixes.size(); }
+
+      private:
+        struct Suffix {
+            VocabularyId id;
+            uint32_t offset;
+        };
+        std::string_view _text(const Suffix& suffix) const;
+
+        // keeps the arena alive, copying a segment is cheap
+        VocabularySegment m_Segment;
+        std::vector<Suffix> m_Suffixes;
+    };
+
+    // prefix completion over the kana readings or the english translations
+    // of one segment, ascii letters are compared case insensitive
+    //
+    // keys are sorted, so all keys starting with a prefix are the range of
+    // one trie node, a min tree over the key ranks yields the best keys of
+    // such a range one by one without looking at the rest of it
+    //
+    // the same implicit trie is walked for the approximate search, a node
+    // is skipped as soon as no key below it can be close enough
+    struct CompletionIndex {
+        enum class Keys { Kana, English };
+
+        struct Completion {
+            // lower is better, comparable between segments:
+            // exact matches first, then by jlpt level and key length
+            uint64_t rank;
+            VocabularyId id;
+        };
+
+        CompletionIndex() = default;
+        CompletionIndex(VocabularySegment segment, Keys keys);
+
+        // up to 'limit' distinct vocabularies having a key starting with
+        // 'prefix', best first
+        std::vector<Completion> complete(std::string_view prefix,
+                                         size_t limit) const;
+
+        struct Match {
+            // levenshtein distance in characters
+            uint32_t distance;
+            VocabularyId id;
+        };
+
+        // all vocabularies having a key within 'maxDistance' edits of
+        // 'query', ascending by id, meant for small distances only
+        std::vector<Match> findSimilar(std::string_view query,
+                                       uint32_t maxDistance) const;
+
+        // positions [first, second) of all keys equal to 'key'
+        std::pair<size_t, size_t> equalRange(std::string_view key) const;
+        VocabularyId getId(size_t pos) const { return this->m_Keys[pos].id; }
+
+        size_t keyCount() const { return this->m_Keys.size(); }
+
+        static bool startsWith(std::string_view key, std::string_view prefix);
+
+      private:
+        struct Key {
+            uint32_t string;
+            VocabularyId id;
+        };
+        std::string_view _text(const Key& key) const {
+            return this->m_Segment.getString(key.string);
+        }
+
+        static constexpr const size_t NoKey = size_t(-1);
+
+        // position of the better key, 'lhs' may be NoKey
+        size_t _better(size_t lhs, size_t rhs) const;
+        // best key of [begin, end), NoKey for an empty range
+        size_t _best(size_t begin, size_t end) const;
+
+        // visits the keys [begin, end) which share their first 'depth'
+        // bytes, the last row of 'rows' holds the distances of that prefix
+        void _findSimilar(size_t begin, size_t end, size_t depth,
+                          const std::u32string& query, uint32_t maxDistance,
+                          std::vector<uint32_t>& rows,
+                          std::vector<Match>& result) const;
+
+        VocabularySegment m_Segment;
+        std::vector<Key> m_Keys;
+        std::vector<uint32_t> m_Ranks;
+
+        // m_MinTree[size + i] = i, every inner node holds the
+        // better position of its two children
+        std::vector<uint32_t> m_MinTree;
+    };
+
+} // namespace detail
@@ -2,15 +2,19 @@
 
 #include <boost/filesystem.hpp>
 
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "detail/transcode.h"
+
 namespace detail {
 
-    std::wstring convertUtf8Wstring(const std::string& str);
-    std::string convertWstringUtf8(const std::wstring& str);
+    // search limit keeping every result
+    inline constexpr const size_t NoLimit = std::numeric_limits<size_t>::max();
 
     struct Vocabulary {
         enum class Type {
@@ -26,28 +30,35 @@ namespace detail {
 
         Type type = Type::UNKNOWN;
 
-        std::wstring kana;
-        std::wstring kanji;
-        std::vector<std::wstring> english;
+        // how common the word is, taken from the jmdict priority tags of
+        // the kept (first) reading and spelling, lower is more common,
+        // derived data so not part of operator==
+        static constexpr const uint8_t NoFrequency = 0xFF;
+        uint8_t frequency = NoFrequency;
+
+        // all text is utf-8
+        std::string kana;
+        std::string kanji;
+        std::vector<std::string> english;
 
         Vocabulary() = default;
-        Vocabulary(std::wstring_view _kana,
-                   const std::vector<std::wstring>& _english,
-                   Type _type = Type::UNKNOWN, std::wstring_view _kanji = L"");
+        Vocabulary(std::string_view _kana,
+                   const std::vector<std::string>& _english,
+                   Type _type = Type::UNKNOWN, std::string_view _kanji = "");
 
         bool operator==(const Vocabulary& rhs) const;
         bool operator!=(const Vocabulary& rhs) const;
 
-        // not yet working
-        [[nodiscard]] static std::wstring
-            ConvertKanaToRomanji(std::wstring_view kana);
+        // hepburn, see convertKanaToRomaji
+        [[nodiscard]] static std::string
+            ConvertKanaToRomanji(std::string_view kana);
 
-        [[nodiscard]] static std::wstring
-            ConvertKanaToHiraganaOnly(std::wstring_view kana);
-        [[nodiscard]] static std::wstring
-            ConvertKanaToKatakanaOnly(std::wstring_view kana);
+        [[nodiscard]] static std::string
+            ConvertKanaToHiraganaOnly(std::string_view kana);
+        [[nodiscard]] static std::string
+            ConvertKanaToKatakanaOnly(std::string_view kana);
 
-        friend std::wostream& operator<<(std::wostream& os,
+        friend std::ostream& operator<<(std::ostream& os,
                                          const Vocabulary& voc);
 
         static const std::vector<Vocabulary> HiraganaMultiCharacters;
@@ -58,11 +69,14 @@ namespace detail {
     };
 
     struct VocabularyVector : public std::vector<Vocabulary> {
+        // the best 'limit' matches, exact ones first, then by jlpt level
+        // and frequency, english is compared by its normalized key
         [[nodiscard]] std::vector<const_iterator>
-            findAllEnglish(std::wstring_view english) const;
+            findAllEnglish(std::string_view english,
+                           size_t limit = NoLimit) const;
 
         [[nodiscard]] std::vector<const_iterator>
-            findAllKana(std::wstring_view kana) const;
+            findAllKana(std::string_view kana, size_t limit = NoLimit) const;
 
         [[nodiscard]] std::vector<const_iterator>
             findAllByType(Vocabulary::Type type) const;
@@ -71,6 +85,15 @@ namespace detail {
             findAllIf(std::function<bool(const Vocabulary&)> predicate) const;
     };
 
+    // single card of an anki database, html is already stripped
+    struct AnkiParseResult {
+        std::string utf8question;
+        std::string utf8answer;
+        bool operator<(const AnkiParseResult& rhs) const {
+            return this->utf8question < rhs.utf8question;
+        }
+    };
+
     struct VocParser {
         VocParser() = delete;
 
@@ -81,11 +104,40 @@ namespace detail {
         [[nodiscard]] static std::optional<VocabularyVector>
             parseJMDictData(std::string_view data);
 
+        // streaming versions of the above, entries are parsed one at a time
+        // and handed to 'onVocabulary' right away, so neither the whole
+        // document nor all of the vocabulary have to be kept in memory
+        static bool parseJMDictFile(
+            const boost::filesystem::path& filePath,
+            const std::function<void(Vocabulary&&)>& onVocabulary);
+        static bool parseJMDictData(
+            std::string_view data,
+            const std::function<void(Vocabulary&&)>& onVocabulary);
+
+        // splits the data at entry boundaries and parses the chunks on
+        // 'threadCount' threads (0 = one per core), the result keeps the
+        // order of the file
+        [[nodiscard]] static std::optional<VocabularyVector>
+            parseJMDictFileParallel(const boost::filesystem::path& filePath,
+                                    size_t threadCount = 0);
+        [[nodiscard]] static std::optional<VocabularyVector>
+            parseJMDictDataParallel(std::string_view data,
+                                    size_t threadCount = 0);
+
         // parse anki files from:
         // http://www.tanos.co.uk/jlpt/
         [[nodiscard]] static std::optional<VocabularyVector> parseAnkiDataBase(
             const boost::filesystem::path& fileNameKanjiEng,
             const boost::filesystem::path& fileNameKanjiHiragana);
+
+        // both steps of parseAnkiDataBase on their own,
+        // every database can be read independent of the others
+        [[nodiscard]] static std::vector<AnkiParseResult>
+            readAnkiDataBaseSorted(const boost::filesystem::path& fileName);
+        [[nodiscard]] static std::optional<VocabularyVector>
+            mergeAnkiDataBases(
+                const std::vector<AnkiParseResult>& sortedKanjiEng,
+                const std::vector<AnkiParseResult>& sortedKanjiHiragana);
     };
 
 } // namespace detail
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "detail/normalize.h"
+#include "detail/vocabparse.h"
+
+namespace detail {
+
+    namespace impl {
+
+        // the best 'limit' first, ranked by exact match, jlpt level and
+        // frequency, ties keep their order and the rest is dropped
+        //
+        // the best ones are selected in linear time, only those are sorted
+        template <typename _IteratorType, typename _PartitonFunction>
+        void _orderFindResult(std::vector<_IteratorType>& result,
+                              _PartitonFunction&& partitionFunc,
+                              size_t limit = NoLimit) {
+            // rank in the upper 16 bits, position below
+            constexpr const uint64_t PositionMask = (uint64_t(1) << 48) - 1;
+            std::vector<uint64_t> keys(result.size());
+            for (size_t i = 0; i < result.size(); ++i) {
+                const auto iter = result[i];
+                keys[i] = (uint64_t(!partitionFunc(iter)) << 63) |
+                          (uint64_t(iter->type) << 56) |
+                          (uint64_t(iter->frequency) << 48) | i;
+            }
+
+            const auto kept = std::min(limit, keys.size());
+            if (kept < keys.size())
+                std::nth_element(keys.begin(), keys.begin() + kept, keys.end());
+            std::sort(keys.begin(), keys.begin() + kept);
+
+            std::vector<_IteratorType> ordered;
+            ordered.reserve(kept);
+            for (size_t i = 0; i < kept; ++i)
+                ordered.push_back(result[keys[i] & PositionMask]);
+            result.swap(ordered);
+        }
+
+        template <typename _IteratorType, typename _VocManager,
+                  typename _SearchFunction, typename _PartitonFunction>
+        std::vector<_IteratorType> _findAll(_VocManager& voc,
+                                            _SearchFunction&& searchFunc,
+                                            _PartitonFunction&& partitionFunc,
+                                            size_t limit = NoLimit) {
+            std::vector<_IteratorType> result;
+            for (auto iter = std::find_if(voc.begin(), voc.end(), searchFunc);
+                 iter != voc.end();
+                 ++iter, iter = std::find_if(iter, voc.end(), searchFunc))
+                result.push_back(iter);
+
+            _orderFindResult(result,
+                             std::forward<_PartitonFunction>(partitionFunc),
+                             limit);
+            return result;
+        }
+
+        // 'english' occurs in 'str' delimited by spaces or the string ends
+        inline bool _containsWords(std::string_view str,
+                                   std::string_view english) {
+            if (english.empty())
+                return false;
+
+            for (auto start = str.find(english); start != str.npos;
+                 start = str.find(english, start + 1)) {
+                const auto end = start + english.size();
+                if ((start == 0 || str[start - 1] == ' ') &&
+                    (end == str.size() || str[end] == ' ')) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        template <typename _Vocabulary>
+        bool _matchesEnglish(const _Vocabulary& voc, std::string_view english) {
+            return std::find_if(voc.english.begin(), voc.english.end(),
+                                [&](const auto& str) {
+                                    return _containsWords(str, english);
+                                }) != voc.english.end();
+        }
+
+        // for vocabulary without precomputed keys, every translation is
+        // normalized into the same buffer, which is only rarely reallocated
+        template <typename _IteratorType, typename _VocManager>
+        std::vector<_IteratorType> _findAllEnglish(_VocManager& voc,
+                                                   std::string_view english,
+                                                   size_t limit = NoLimit) {
+            std::string queryBuffer;
+            english = normalizeEnglish(english, queryBuffer);
+
+            std::string buffer;
+            auto anyKey = [&buffer](const auto& voc, auto&& predicate) {
+                return std::any_of(voc.english.begin(), voc.english.end(),
+                                   [&](std::string_view str) {
+                                       return predicate(
+                                           normalizeEnglish(str, buffer));
+                                   });
+            };
+            auto searchFunc = [&](const auto& voc) {
+                return anyKey(voc, [english](std::string_view key) {
+                    return _containsWords(key, english);
+                });
+            };
+            auto partitionFunc = [&](const _IteratorType iter) {
+                return anyKey(*iter, [english](std::string_view key) {
+                    return key == english;
+                });
+            };
+            return _findAll<_IteratorType>(voc, searchFunc, partitionFunc,
+                                           limit);
+        }
+
+        template <typename _IteratorType>
+        auto _exactKanaPartition(std::string_view kana) {
+            return [kana](const _IteratorType i) { return i->kana == kana; };
+        }
+
+        template <typename _IteratorType, typename _VocManager>
+        std::vector<_IteratorType> _findAllKana(_VocManager& voc,
+                                                std::string_view kana,
+                                                size_t limit = NoLimit) {
+            auto searchFunction = [&](const auto& str) {
+                return str.kana.find(kana) != str.kana.npos;
+            };
+            return _findAll<_IteratorType>(
+                voc, searchFunction, _exactKanaPartition<_IteratorType>(kana),
+                limit);
+        }
+
+    } // namespace impl
+
+} // namespace detail
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include "detail/vocabparse.h"
+
+namespace detail {
+
+    using VocabularyId = uint32_t;
+
+    struct VocabularySegment;
+
+    // read only view of a single vocabulary of a VocabularySegment,
+    // members mirror the ones of Vocabulary
+    struct VocabularyRef {
+        struct EnglishRange {
+            struct const_iterator {
+                using iterator_category = std::random_access_iterator_tag;
+                using value_type = std::string_view;
+                using difference_type = std::ptrdiff_t;
+                using pointer = const std::string_view*;
+                using reference = std::string_view;
+
+                const_iterator() = default;
+                const_iterator(const VocabularySegment* segment, uint32_t idx)
+                    : m_Segment(segment), m_Idx(idx) {}
+
+                reference operator*() const;
+                reference operator[](difference_type n) const {
+                    return *(*this + n);
+                }
+
+                const_iterator& operator++() {
+                    ++this->m_Idx;
+                    return *this;
+                }
+                const_iterator operator++(int) {
+                    auto tmp = *this;
+                    ++this->m_Idx;
+                    return tmp;
+                }
+                const_iterator& operator--() {
+                    --this->m_Idx;
+                    return *this;
+                }
+                const_iterator& operator+=(difference_type n) {
+                    this->m_Idx = uint32_t(difference_type(this->m_Idx) + n);
+                    return *this;
+                }
+                friend const_iterator operator+(const_iterator iter,
+                                                difference_type n) {
+                    return iter += n;
+                }
+                friend difference_type operator-(const_iterator lhs,
+                                                 const_iterator rhs) {
+                    return difference_type(lhs.m_Idx) -
+                           difference_type(rhs.m_Idx);
+                }
+
+                bool operator==(const const_iterator& rhs) const {
+                    return this->m_Idx == rhs.m_Idx;
+                }
+                bool operator!=(const const_iterator& rhs) const {
+                    return this->m_Idx != rhs.m_Idx;
+                }
+                bool operator<(const const_iterator& rhs) const {
+                    return this->m_Idx < rhs.m_Idx;
+                }
+
+              private:
+                const VocabularySegment* m_Segment = nullptr;
+                uint32_t m_Idx = 0;
+            };
+
+            EnglishRange() = default;
+            EnglishRange(const VocabularySegment* segment, uint32_t begin,
+                         uint32_t size)
+                : m_Segment(segment), m_Begin(begin), m_Size(size) {}
+
+            size_t size() const { return this->m_Size; }
+            bool empty() const { return this->m_Size == 0; }
+            std::string_view operator[](size_t idx) const {
+                return this->begin()[difference_type(idx)];
+            }
+            std::string_view front() const { return *this->begin(); }
+
+            const_iterator begin() const {
+                return {this->m_Segment, this->m_Begin};
+            }
+            const_iterator end() const {
+                return {this->m_Segment, this->m_Begin + this->m_Size};
+            }
+            const_iterator cbegin() const { return this->begin(); }
+            const_iterator cend() const { return this->end(); }
+
+          private:
+            using difference_type = const_iterator::difference_type;
+
+            const VocabularySegment* m_Segment = nullptr;
+            uint32_t m_Begin = 0;
+            uint32_t m_Size = 0;
+        };
+
+        Vocabulary::Type type = Vocabulary::Type::UNKNOWN;
+        uint8_t frequency = Vocabulary::NoFrequency;
+
+        std::string_view kana;
+        std::string_view kanji;
+        EnglishRange english;
+
+        // owning copy, e.g. to add it to a deck
+        [[nodiscard]] Vocabulary toVocabulary() const;
+
+        bool operator==(const Vocabulary& rhs) const;
+        bool operator!=(const Vocabulary& rhs) const;
+    };
+
+    // immutable list of vocabulary stored as struct of arrays, all text
+    // lives in one continuous character arena which is referenced by
+    // fixed size records, so a segment needs only a few allocations
+    //
+    // records are ordered by type and frequency, so every jlpt level is
+    // one continuous range of the segment and ascending ids are the order
+    // search results are ranked in
+    //
+    // the arrays are either owned by the segment or point to external
+    // memory, e.g. a memory mapped snapshot, which 'owner' keeps alive
+    struct VocabularySegment {
+        struct Record {
+            uint16_t type;
+            uint16_t frequency;
+            uint32_t kana;
+            uint32_t kanji;
+            uint32_t englishBegin;
+            uint32_t englishCount;
+        };
+
+        struct StringRef {
+            uint32_t offset;
+            uint32_t length;
+        };
+
+        static constexpr const size_t TypeCount =
+            size_t(Vocabulary::Type::UNKNOWN) + 1;
+        using Range = std::pair<uint32_t, uint32_t>;
+
+        VocabularySegment() = default;
+        // vocabulary of the same type and frequency
+        // is kept in its original order
+        explicit VocabularySegment(const VocabularyVector& vocs);
+        VocabularySegment(const Record* records, size_t recordCount,
+                          const StringRef* strings, size_t stringCount,
+                          const char* chars, size_t charCount,
+                          std::shared_ptr<const void> owner);
+
+        size_t size() const { return this->m_RecordCount; }
+        // indices [first, second) of all vocabulary of 'type'
+        Range getTypeRange(Vocabulary::Type type) const {
+            return this->m_TypeRanges[size_t(type)];
+        }
+        bool empty() const { return this->m_RecordCount == 0; }
+        VocabularyRef operator[](size_t idx) const;
+
+        // raw arrays, e.g. to write a snapshot
+        const Record* records() const { return this->m_Records; }
+        const StringRef* strings() const { return this->m_Strings; }
+        size_t stringCount() const { return this->m_StringCount; }
+        const char* chars() const { return this->m_Chars; }
+        size_t charCount() const { return this->m_CharCount; }
+
+        std::string_view getString(uint32_t idx) const {
+            const auto& str = this->m_Strings[idx];
+            return {this->m_Chars + str.offset, str.length};
+        }
+
+        // segment sharing the records of this one, the english translations
+        // are replaced by their keys, see normalizeEnglish, kana and kanji
+        // are left empty, so the ids of both refer to the same vocabulary
+        [[nodiscard]] VocabularySegment englishKeys() const;
+
+        // all references inside the arrays are in bounds
+        // and the records are ordered by type and frequency
+        bool isValid() const;
+
+      private:
+        void _computeTypeRanges();
+
+        const Record* m_Records = nullptr;
+        size_t m_RecordCount = 0;
+        const StringRef* m_Strings = nullptr;
+        size_t m_StringCount = 0;
+        const char* m_Chars = nullptr;
+        size_t m_CharCount = 0;
+        std::shared_ptr<const void> m_Owner;
+        std::array<Range, TypeCount> m_TypeRanges{};
+    };
+
+    inline std::string_view
+        VocabularyRef::EnglishRange::const_iterator::operator*() const {
+        return this->m_Segment->getString(this->m_Idx);
+    }
+
+} // namespace detail
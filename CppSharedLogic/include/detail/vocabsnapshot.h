@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "detail/vocabstore.h"
+
+namespace detail {
+
+    // precompiled binary image of already parsed vocabulary,
+    // used to skip parsing the anki databases on startup
+    //
+    // layout: Header | Entry[entryCount] | StringRef[stringCount] | chars
+    // the payload matches the arrays of a VocabularySegment
+    struct VocabularySnapshot {
+        VocabularySnapshot() = delete;
+
+        // has to be increased whenever the layout changes
+        static constexpr const uint32_t Version = 3;
+
+        // fingerprint of the files a snapshot was built from (name, size
+        // and last write time), a snapshot with a different fingerprint
+        // is considered outdated
+        [[nodiscard]] static uint64_t fingerprintFiles(
+            const std::vector<boost::filesystem::path>& files);
+
+        // returns nothing if the file is missing, corrupt or outdated,
+        // the segment references the memory mapped file directly
+        [[nodiscard]] static std::optional<VocabularySegment>
+            read(const boost::filesystem::path& filePath,
+                 uint64_t fingerprint);
+
+        static bool write(const boost::filesystem::path& filePath,
+                          const VocabularySegment& segment,
+                          uint64_t fingerprint);
+    };
+
+} // namespace detail
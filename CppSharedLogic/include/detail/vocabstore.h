@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <optional>
+
+#include "detail/vocabindex.h"
+#include "detail/vocabsegment.h"
+
+namespace detail {
+
+    // single owner of all dictionary vocabulary, split into segments
+    // (e.g. anki and jmdict) which are addressed as one continuous range
+    //
+    // segments are only ever appended, so ids, references and iterators
+    // stay valid for the lifetime of the store and a single writer may
+    // append while others are reading
+    struct VocabularyStore {
+        static constexpr const size_t MaxSegments = 4;
+
+        struct const_iterator {
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = VocabularyRef;
+            using difference_type = std::ptrdiff_t;
+            using reference = VocabularyRef;
+
+            // operator-> has to return something pointer like
+            struct pointer {
+                VocabularyRef ref;
+                const VocabularyRef* operator->() const { return &this->ref; }
+            };
+
+            const_iterator() = default;
+            const_iterator(const VocabularyStore* store, VocabularyId id)
+                : m_Store(store), m_Id(id) {}
+
+            VocabularyId id() const { return this->m_Id; }
+
+            reference operator*() const { return (*this->m_Store)[this->m_Id]; }
+            pointer operator->() const { return {**this}; }
+            reference operator[](difference_type n) const {
+                return *(*this + n);
+            }
+
+            const_iterator& operator++() {
+                ++this->m_Id;
+                return *this;
+            }
+            const_iterator operator++(int) {
+                auto tmp = *this;
+                ++this->m_Id;
+                return tmp;
+            }
+            const_iterator& operator--() {
+                --this->m_Id;
+                return *this;
+            }
+            const_iterator operator--(int) {
+                auto tmp = *this;
+                --this->m_Id;
+                return tmp;
+            }
+            const_iterator& operator+=(difference_type n) {
+                this->m_Id = VocabularyId(difference_type(this->m_Id) + n);
+                return *this;
+            }
+            const_iterator& operator-=(difference_type n) {
+                return *this += -n;
+            }
+            friend const_iterator operator+(const_iterator iter,
+                                            difference_type n) {
+                return iter += n;
+            }
+            friend const_iterator operator+(difference_type n,
+                                            const_iterator iter) {
+                return iter += n;
+            }
+            friend const_iterator operator-(const_iterator iter,
+                                            difference_type n) {
+                return iter -= n;
+            }
+            friend difference_type operator-(const_iterator lhs,
+                                             const_iterator rhs) {
+                return difference_type(lhs.m_Id) - difference_type(rhs.m_Id);
+            }
+
+            bool operator==(const const_iterator& rhs) const {
+                return this->m_Id == rhs.m_Id;
+            }
+            bool operator!=(const const_iterator& rhs) const {
+                return this->m_Id != rhs.m_Id;
+            }
+            bool operator<(const const_iterator& rhs) const {
+                return this->m_Id < rhs.m_Id;
+            }
+            bool operator>(const const_iterator& rhs) const {
+                return this->m_Id > rhs.m_Id;
+            }
+            bool operator<=(const const_iterator& rhs) const {
+                return this->m_Id <= rhs.m_Id;
+            }
+            bool operator>=(const const_iterator& rhs) const {
+                return this->m_Id >= rhs.m_Id;
+            }
+
+          private:
+            const VocabularyStore* m_Store = nullptr;
+            VocabularyId m_Id = 0;
+        };
+
+        VocabularyStore() = default;
+        VocabularyStore(const VocabularyStore&) = delete;
+        VocabularyStore& operator=(const VocabularyStore&) = delete;
+
+        // returns the id of the first vocabulary of the new segment
+        //
+        // the search indices of a segment are built on its first search,
+        // 'buildIndices' builds them before the segment gets visible,
+        // meant for segments appended in the background
+        VocabularyId appendSegment(VocabularySegment segment,
+                                   bool buildIndices = false);
+
+        size_t segmentCount() const;
+        std::pair<const_iterator, const_iterator>
+            getSegment(size_t segmentIdx) const;
+
+        // segments are grouped by type, so each jlpt level is one
+        // continuous range per segment, all of these are O(segments)
+        std::pair<const_iterator, const_iterator>
+            getTypeRange(size_t segmentIdx, Vocabulary::Type type) const;
+        size_t countByType(Vocabulary::Type type) const;
+        // the n-th vocabulary of 'type' in id order, n < countByType(type)
+        const_iterator getByType(Vocabulary::Type type, size_t n) const;
+
+        size_t size() const;
+        bool empty() const;
+        VocabularyRef operator[](VocabularyId id) const;
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        const_iterator cbegin() const;
+        const_iterator cend() const;
+
+        // the best 'limit' matches, exact ones first, then by jlpt level
+        // and frequency, since ids are in that order only the first
+        // 'limit' matches of every segment are looked at
+        //
+        // all english searches compare the normalized keys of the query and
+        // the translations, see normalizeEnglish, answered by the token index
+        [[nodiscard]] std::vector<const_iterator>
+            findAllEnglish(std::string_view english,
+                           size_t limit = NoLimit) const;
+        // only the ones having a translation with the same key as 'english'
+        [[nodiscard]] std::vector<const_iterator>
+            findExactEnglish(std::string_view english,
+                             size_t limit = NoLimit) const;
+
+        // any non empty 'kana' is answered by the substring index
+        [[nodiscard]] std::vector<const_iterator>
+            findAllKana(std::string_view kana, size_t limit = NoLimit) const;
+
+        // the best 'limit' vocabularies using every kanji of 'kanji' in their
+        // spelling, other characters are ignored, an exact spelling first
+        [[nodiscard]] std::vector<const_iterator>
+            findAllKanji(std::string_view kanji, size_t limit = NoLimit) const;
+
+        // up to 'limit' vocabularies whose kana respectively any english
+        // translation starts with 'prefix', exact matches first, then by
+        // jlpt level and length, only the returned ones are looked at
+        [[nodiscard]] std::vector<const_iterator>
+            completeKana(std::string_view prefix, size_t limit) const;
+        [[nodiscard]] std::vector<const_iterator>
+            completeEnglish(std::string_view prefix, size_t limit) const;
+
+        // vocabularies whose kana respectively any whole english translation
+        // is within 'maxDistance' edits of the query, closest first, then
+        // by jlpt level, meant for a distance of 1 or 2
+        [[nodiscard]] std::vector<const_iterator>
+            findSimilarKana(std::string_view kana, uint32_t maxDistance) const;
+        [[nodiscard]] std::vector<const_iterator>
+            findSimilarEnglish(std::string_view english,
+                               uint32_t maxDistance) const;
+
+        // id of the vocabulary equal to 'voc', looked up by its kana
+        [[nodiscard]] std::optional<VocabularyId>
+            findId(const Vocabulary& voc) const;
+
+        // normalized keys of the english translations of 'id', in the
+        // order of the translations
+        VocabularyRef::EnglishRange getEnglishKeys(VocabularyId id) const;
+
+        [[nodiscard]] std::vector<const_iterator>
+            findAllByType(Vocabulary::Type type) const;
+
+        [[nodiscard]] std::vector<const_iterator>
+            findAllIf(
+                std::function<bool(const VocabularyRef&)> predicate) const;
+
+      private:
+        size_t _segmentOf(VocabularyId id) const;
+        VocabularyId _segmentBegin(size_t segmentIdx) const;
+        void _buildIndices(size_t segmentIdx) const;
+        std::vector<const_iterator> _complete(
+            const std::array<CompletionIndex, MaxSegments>& indices,
+            std::string_view prefix, size_t limit) const;
+        std::vector<const_iterator> _findSimilar(
+            const std::array<CompletionIndex, MaxSegments>& indices,
+            std::string_view query, uint32_t maxDistance) const;
+
+        std::array<VocabularySegment, MaxSegments> m_Segments;
+
+        // built exactly once per segment, never changed afterwards
+        mutable std::array<std::once_flag, MaxSegments> m_IndicesBuilt;
+        // see VocabularySegment::englishKeys, the english indices refer to it
+        mutable std::array<VocabularySegment, MaxSegments> m_EnglishKeys;
+        mutable std::array<EnglishTokenIndex, MaxSegments> m_EnglishIndices;
+        mutable std::array<KanaSubstringIndex, MaxSegments> m_KanaIndices;
+        mutable std::array<KanjiIndex, MaxSegments> m_KanjiIndices;
+        mutable std::array<CompletionIndex, MaxSegments> m_KanaCompletions;
+        mutable std::array<CompletionIndex, MaxSegments> m_EnglishCompletions;
+
+        // unpublished segments end at max, so a lookup of
+        // a valid id never touches them
+        std::array<VocabularyId, MaxSegments> m_SegmentEnd = [] {
+            std::array<VocabularyId, MaxSegments> ends;
+            ends.fill(std::numeric_limits<VocabularyId>::max());
+            return ends;
+        }();
+        std::atomic<size_t> m_SegmentCount = 0;
+    };
+
+} // namespace detail
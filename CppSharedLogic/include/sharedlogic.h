@@ -1,17 +1,26 @@
 #pragma once
 
 #include <cinttypes>
+#include <future>
 #include <optional>
+#include <unordered_map>
 
 #include <boost/filesystem.hpp>
 
+#include "detail/querycache.h"
+#include "detail/threadpool.h"
+#include "detail/vocabfilter.h"
 #include "detail/vocabparse.h"
+#include "detail/vocabstore.h"
 
 namespace shared {
 
     struct LogicHandler;
 
     struct VocabularyDeck {
+        // vocabulary of a deck is addressed by its position, ids are dense
+        // and only change if a vocabulary in front of them is removed,
+        // flashcard state is kept in an array indexed by that id
         struct Flashcard {
             using index_type = unsigned;
             static constexpr const unsigned MIN_CARD_INDEX =
@@ -20,7 +29,7 @@ namespace shared {
                 std::numeric_limits<index_type>::max();
 
             index_type cardIndex = Flashcard::MAX_CARD_INDEX;
-            detail::VocabularyVector::const_iterator vocIter;
+            detail::VocabularyId vocId = 0;
 
             bool operator<(const Flashcard& rhs) const;
             bool operator==(const Flashcard& rhs) const;
@@ -31,20 +40,29 @@ namespace shared {
         operator const detail::VocabularyVector&() const;
         const detail::VocabularyVector& getAllVocabularies() const;
 
-        std::optional<Flashcard> getFlashcard(unsigned vocIdx) const;
+        std::optional<detail::VocabularyId>
+            findVocabularyId(const detail::Vocabulary& voc) const;
+
+        std::optional<Flashcard> getFlashcard(detail::VocabularyId vocId) const;
         std::optional<Flashcard>
             getFlashcard(const detail::Vocabulary& voc) const;
-        std::optional<Flashcard>
-            getFlashcard(detail::VocabularyVector::const_iterator citer) const;
 
-        bool setFlashcardIndex(unsigned vocIdx, unsigned newCardIdx);
+        bool setFlashcardIndex(detail::VocabularyId vocId, unsigned newCardIdx);
         bool setFlashcardIndex(const detail::Vocabulary& voc,
                                unsigned newCardIdx);
-        bool setFlashcardIndex(detail::VocabularyVector::const_iterator citer,
-                               unsigned newCardIdx);
 
         bool addFlashcard(const Flashcard& fc);
 
+        // store ids of the deck vocabulary, all of it respectively the ones
+        // with a card index in [minCardIndex, maxCardIndex], vocabulary
+        // missing in 'store' is skipped
+        [[nodiscard]] detail::VocabularyBitmap
+            getStoreBitmap(const detail::VocabularyStore& store) const;
+        [[nodiscard]] detail::VocabularyBitmap
+            getFlashcardBitmap(const detail::VocabularyStore& store,
+                               Flashcard::index_type minCardIndex,
+                               Flashcard::index_type maxCardIndex) const;
+
         bool load(const std::wstring& filename);
 
         bool save();
@@ -59,9 +77,17 @@ namespace shared {
         bool _saveToFile(const std::string &path) const;
         bool _loadFromFile(const std::string &path);
 
+        void _rebuildVocabularyIds();
+        static size_t _vocabularyKey(const detail::Vocabulary& voc);
+
         std::string m_DeckName;
         detail::VocabularyVector m_Vocabulary;
-        std::vector<Flashcard> m_SortedFlashcards;
+
+        // indexed by vocabulary id, empty if the vocabulary has no card
+        std::vector<std::optional<Flashcard::index_type>> m_CardIndices;
+
+        // hash of kana and kanji -> vocabulary id
+        std::unordered_multimap<size_t, detail::VocabularyId> m_VocabularyIds;
         const boost::filesystem::path m_UserFilePath;
     };
 
@@ -157,27 +183,153 @@ namespace shared {
         GenericTranslator() = default;
     };
 
+    struct VocabularyTranslator;
+
+    // store ids found for every query of a batch, kept back to back in one
+    // buffer, the ids of query i are [getOffsets()[i], getOffsets()[i + 1])
+    struct TranslationBatch {
+        // number of queries
+        size_t size() const;
+        size_t count(size_t query) const;
+        // the n-th best match of 'query', n < count(query)
+        detail::VocabularyId getId(size_t query, size_t n) const;
+
+        const std::vector<detail::VocabularyId>& getIds() const;
+        const std::vector<size_t>& getOffsets() const;
+
+      private:
+        friend VocabularyTranslator;
+
+        std::vector<detail::VocabularyId> m_Ids;
+        std::vector<size_t> m_Offsets{0};
+    };
+
+    // store ids of the matches of a search, best match first, nothing is
+    // copied out of the store until a field of a match is asked for
+    struct SearchResult {
+        size_t size() const;
+        bool empty() const;
+        detail::VocabularyId getId(size_t idx) const;
+        const std::vector<detail::VocabularyId>& getIds() const;
+
+        // copies up to 'capacity' ids to 'ids' and returns their number,
+        // lets java fill an int array with a single call
+        size_t copyIds(int32_t* ids, size_t capacity) const;
+
+      private:
+        friend VocabularyTranslator;
+
+        std::vector<detail::VocabularyId> m_Ids;
+    };
+
     struct VocabularyTranslator {
-        std::wstring translateKana(const std::wstring &kana) const;
-        std::wstring translateEnglish(const std::wstring &english) const;
+        // the best 'limit' matches, exact ones first, then the
+        // common ones, 'kana' may also be hepburn romaji, english
+        // ignores case, punctuation and notes like "(to)"
+        std::wstring translateKana(const std::wstring &kana,
+                                   size_t limit = 10) const;
+        std::wstring translateEnglish(const std::wstring &english,
+                                      size_t limit = 10) const;
+
+        // words using every kanji of 'kanji', one line per word
+        // holding its spelling, kana and english translations
+        std::wstring translateKanji(const std::wstring& kanji,
+                                    size_t limit = 10) const;
+
+        // like translateKana / translateEnglish, but matches whole readings
+        // respectively translations with up to 'maxDistance' typos,
+        // closest matches first
+        std::wstring translateSimilarKana(const std::wstring& kana,
+                                          unsigned maxDistance = 1) const;
+        std::wstring translateSimilarEnglish(const std::wstring& english,
+                                             unsigned maxDistance = 1) const;
+
+        // the matches of translateKana / translateEnglish / translateKanji
+        // as ids, read their fields with the getters below
+        SearchResult searchKana(const std::wstring& kana,
+                                size_t limit = 10) const;
+        SearchResult searchEnglish(const std::wstring& english,
+                                   size_t limit = 10) const;
+        SearchResult searchKanji(const std::wstring& kanji,
+                                 size_t limit = 10) const;
+
+        // fields of the vocabulary with store id 'id', an id outside of the
+        // store respectively n >= getEnglishCount(id) throws
+        // std::out_of_range
+        std::wstring getKana(detail::VocabularyId id) const;
+        std::wstring getKanji(detail::VocabularyId id) const;
+        size_t getEnglishCount(detail::VocabularyId id) const;
+        std::wstring getEnglish(detail::VocabularyId id, size_t n) const;
+        detail::Vocabulary::Type getType(detail::VocabularyId id) const;
+
+        // ids of what translateKana / translateEnglish would return for
+        // each query, all queries are spread over a pool of worker threads
+        // which is started on the first batch, the cache is not involved
+        TranslationBatch
+            translateKanaBatch(const std::vector<std::wstring>& kana,
+                               size_t limit = 10) const;
+        TranslationBatch
+            translateEnglishBatch(const std::vector<std::wstring>& english,
+                                  size_t limit = 10) const;
+
+        // distinct kana readings respectively english translations starting
+        // with 'prefix', best matches first, meant for search as you type
+        std::vector<std::wstring> completeKana(const std::wstring& prefix,
+                                               size_t limit = 10) const;
+        std::vector<std::wstring> completeEnglish(const std::wstring& prefix,
+                                                  size_t limit = 10) const;
+
+        // the translate functions answer repeated queries from a cache,
+        // it is dropped as soon as vocabulary is added to the store
+        uint64_t getCacheHits() const;
+        uint64_t getCacheMisses() const;
+        void clearCache() const;
 
     protected:
         friend LogicHandler;
-        VocabularyTranslator(const detail::VocabularyVector& manager);
+        VocabularyTranslator(const detail::VocabularyStore& manager);
 
       private:
-        const detail::VocabularyVector& m_VocabularyMaanger;
+        template <typename _Compute>
+        std::wstring _cached(detail::QueryCache::Kind kind, size_t parameter,
+                             std::string_view query,
+                             _Compute&& compute) const;
+        // the ids come from java and are checked
+        detail::VocabularyRef _vocabulary(detail::VocabularyId id) const;
+        static SearchResult _toSearchResult(
+            const std::vector<detail::VocabularyStore::const_iterator>& vocs);
+        template <typename _Find>
+        TranslationBatch
+            _translateBatch(const std::vector<std::wstring>& queries,
+                            _Find&& find) const;
+
+        const detail::VocabularyStore& m_VocabularyMaanger;
+        mutable detail::QueryCache m_Cache;
+
+        mutable std::once_flag m_PoolStarted;
+        mutable std::unique_ptr<detail::util::ThreadPool> m_Pool;
     };
 
     struct LogicHandler {
-        // jmdict is not recommended due to to many vocabulary and other reasons
+        // parsed anki databases are cached as snapshot in databasesDirectory
+        // jmdict is loaded in the background, the handler is usable right
+        // away with the anki vocabulary only
         LogicHandler(const std::string &databasesDirectory,
                      const std::string &userFilePath,
                      bool enableJmdict = false);
+        LogicHandler(const LogicHandler&) = delete;
+        LogicHandler& operator=(const LogicHandler&) = delete;
+        ~LogicHandler();
 
-        const detail::VocabularyVector& getAllVocabulary() const;
+        // anki vocabulary until jmdict is ready, anki and jmdict afterwards
+        const detail::VocabularyStore& getAllVocabulary() const;
         const VocabularyTranslator& getVocabularyTranslator() const;
 
+        // always true if jmdict is disabled
+        bool isJmdictReady() const;
+        void waitForJmdict() const;
+        std::shared_future<void> getJmdictReadiness() const;
+
         VocabularyDeck createVocabularyDeck() const;
         QuestionHandler createQuestionHandler() const;
         GenericTranslator createGenericTranslator() const;
@@ -187,16 +339,31 @@ namespace shared {
         bool removeDeck(const std::wstring& filename) const;
         std::shared_ptr<const VocabularyDeck> getCurrentDeck() const;
 
+        // attribute bitmaps of getAllVocabulary(), rebuilt
+        // on the first call after jmdict has been appended
+        std::shared_ptr<const detail::VocabularyAttributes>
+            getVocabularyAttributes() const;
+
+        // deck building, up to 'count' random vocabularies of 'level'
+        // which are not part of the current deck yet
+        detail::VocabularyVector
+            suggestVocabularies(detail::Vocabulary::Type level, size_t count,
+                                bool kanjiOnly = false) const;
+
       private:
         std::shared_ptr<VocabularyDeck> m_CurrentDeck;
 
+        // anki segment, jmdict is appended by the background loader,
+        // declared before the translator which references it
+        detail::VocabularyStore m_Vocabulary;
         const VocabularyTranslator m_Translator;
         const boost::filesystem::path m_UserFilePath;
-        const detail::VocabularyVector m_AnkiVocabulary;
-        const detail::VocabularyVector m_JmdictVocabulary;
 
-        // has to be the last VocVector due to initializatin order
-        const detail::VocabularyVector m_AllVocabulary;
+        std::shared_future<void> m_JmdictReadiness;
+
+        mutable std::mutex m_AttributesMutex;
+        mutable std::shared_ptr<const detail::VocabularyAttributes>
+            m_Attributes;
     };
 
 } // namespace shared
@@ -1,5 +1,7 @@
 #include "sharedlogic.h"
+#include "detail/util.hpp"
 #include <iostream>
+#include <sstream>
 #include <unordered_map>
 
 static constexpr std::wstring_view StartLoop = L"start ";
@@ -63,7 +65,99 @@ static void translate(shared::LogicHandler& lh, bool forever) {
         if (line == FinishLoop)
             break;
 
-        sioh.writeLine(translator.translateEnglish(line));
+        auto result = translator.translateEnglish(line);
+        if (result.empty()) {
+            sioh.writeLine(L"no exact match, similar words:");
+            result = translator.translateSimilarEnglish(line, 2);
+        }
+        sioh.writeLine(result);
+    } while (forever);
+}
+
+static void translateList(shared::LogicHandler& lh, bool forever) {
+    const auto& translator = lh.getVocabularyTranslator();
+    const auto& store = lh.getAllVocabulary();
+    SimpleIOHandler sioh;
+    do {
+        sioh.writeLine();
+        sioh.writeLine(L"comma separated english words", true);
+        const auto line = sioh.readLine();
+        if (line == FinishLoop)
+            break;
+
+        std::vector<std::wstring> words;
+        std::wstringstream stream(line);
+        for (std::wstring word; std::getline(stream, word, L',');) {
+            const auto begin = word.find_first_not_of(L' ');
+            const auto end = word.find_last_not_of(L' ');
+            if (begin != std::wstring::npos)
+                words.push_back(word.substr(begin, end - begin + 1));
+        }
+
+        const auto batch = translator.translateEnglishBatch(words, 3);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            std::string kana;
+            for (size_t n = 0; n < batch.count(i); ++n) {
+                if (n)
+                    kana += ", ";
+                kana += store[batch.getId(i, n)].kana;
+            }
+            sioh.writeLine(words[i] + L"\t\t" +
+                           detail::convertUtf8Wstring(kana));
+        }
+    } while (forever);
+}
+
+static void kanji(shared::LogicHandler& lh, bool forever) {
+    const auto& translator = lh.getVocabularyTranslator();
+    SimpleIOHandler sioh;
+    do {
+        sioh.writeLine();
+        sioh.writeLine(L"words using kanji", true);
+        const auto line = sioh.readLine();
+        if (line == FinishLoop)
+            break;
+
+        sioh.writeLine(translator.translateKanji(line));
+    } while (forever);
+}
+
+static void complete(shared::LogicHandler& lh, bool forever) {
+    const auto& translator = lh.getVocabularyTranslator();
+    SimpleIOHandler sioh;
+    do {
+        sioh.writeLine();
+        sioh.writeLine(L"complete word", true);
+        const auto line = sioh.readLine();
+        if (line == FinishLoop)
+            break;
+
+        for (const auto& e : translator.completeEnglish(line))
+            sioh.writeLine(e);
+        for (const auto& e : translator.completeKana(line))
+            sioh.writeLine(e);
+    } while (forever);
+}
+
+static void suggest(shared::LogicHandler& lh, bool forever) {
+    SimpleIOHandler sioh;
+    do {
+        sioh.writeLine();
+        sioh.writeLine(L"jlpt level (n5 - n1)", true);
+        const auto line = sioh.readLine();
+        if (line == FinishLoop)
+            break;
+        if (line.size() != 2 || line[0] != L'n' || line[1] < L'1' ||
+            line[1] > L'5') {
+            sioh.writeLine(L"unknown level");
+            continue;
+        }
+
+        const auto level = detail::Vocabulary::Type(L'5' - line[1]);
+        for (const auto& e : lh.suggestVocabularies(level, 10)) {
+            sioh.writeLine(detail::convertUtf8Wstring(e.kana + "\t\t" +
+                                                      e.english.front()));
+        }
     } while (forever);
 }
 
@@ -71,7 +165,8 @@ static void listVocabularies(shared::LogicHandler& lh, bool) {
     auto deck = lh.getCurrentDeck();
     SimpleIOHandler sioh;
     for (const auto& e : deck->getAllVocabularies())
-        sioh.writeLine(e.kana + L"\t\t" + e.english.front());
+        sioh.writeLine(
+            detail::convertUtf8Wstring(e.kana + "\t\t" + e.english.front()));
 }
 
 static void createDeck(shared::LogicHandler& lh, bool) {
@@ -82,26 +177,33 @@ static void createDeck(shared::LogicHandler& lh, bool) {
     while (true) {
         sioh.writeLine();
         sioh.writeLine(L"Add a english word to deck", true);
-        auto english = sioh.readLine();
-        if (english == FinishLoop)
+        const auto line = sioh.readLine();
+        if (line == FinishLoop)
             break;
 
-        const auto vocabularies = lh.getAllVocabulary().findAllIf(
-            [english](const detail::Vocabulary& voc) {
-                for (const auto& e : voc.english) {
-                    auto cpy = e;
-                    std::for_each(cpy.begin(), cpy.end(), ::tolower);
-                    if (cpy == english)
-                        return true;
-                }
-                return false;
-            });
+        // case and punctuation are ignored, e.g. "(to) Eat" matches "eat"
+        const auto english = detail::convertWstringUtf8(line);
+        const auto vocabularies =
+            lh.getAllVocabulary().findExactEnglish(english, 1);
 
         if (!vocabularies.empty()) {
-            sioh.writeLine(L"found vocabulary: " + vocabularies.front()->kana);
-            newDeck.addVocabularyUnique(*vocabularies.front());
-        } else
+            const auto& kana = vocabularies.front()->kana;
+            sioh.writeLine(L"found vocabulary: " +
+                           detail::convertUtf8Wstring(kana));
+            newDeck.addVocabularyUnique(vocabularies.front()->toVocabulary());
+        } else {
             sioh.writeLine(L"vocabulary not found, nothing has been added!");
+            const auto similar =
+                lh.getAllVocabulary().findSimilarEnglish(english, 2);
+            if (!similar.empty())
+                sioh.writeLine(L"did you mean:");
+            for (size_t i = 0; i < similar.size() && i < 5; ++i) {
+                const auto voc = *similar[i];
+                sioh.writeLine(detail::convertUtf8Wstring(
+                    std::string(voc.kana) + "\t\t" +
+                    detail::util::combineStringContainerToString(voc.english)));
+            }
+        }
     }
     newDeck.saveAs(name);
     lh.loadDeck(name);
@@ -129,7 +231,9 @@ static const std::unordered_map<std::wstring,
         {L"list decks", listDecks},   {L"questions", questioning},
         {L"translate", translate},    {L"list vocs", listVocabularies},
         {L"create deck", createDeck}, {L"load deck", loadDeck},
-        {L"remove deck", removeDeck},
+        {L"remove deck", removeDeck}, {L"complete", complete},
+        {L"suggest", suggest},        {L"kanji", kanji},
+        {L"translate list", translateList},
 };
 
 static void printUsage() {
@@ -0,0 +1,37 @@
+#include "detail/romaji.h"
+#include <iostream>
+#include <string_view>
+
+struct Spelling {
+    std::string_view romaji;
+    std::string_view kana;
+    detail::KanaScript script = detail::KanaScript::Hiragana;
+};
+
+// the spellings of ん which are easy to get wrong
+static constexpr const Spelling Spellings[] = {
+    {"shinnbunn", u8"しんぶん"},
+    {"kannji", u8"かんじ"},
+    {"konnnichiha", u8"こんにちは"},
+    {"konnichiha", u8"こんにちは"},
+    {"kinnyoubi", u8"きんようび"},
+    {"kin'youbi", u8"きんようび"},
+    {"shinn'you", u8"しんよう"},
+    {"onna", u8"おんな"},
+    {"onnna", u8"おんな"},
+    {"hon", u8"ほん"},
+    {"kannji", u8"カンジ", detail::KanaScript::Katakana},
+};
+
+int main() {
+    int failed = 0;
+    for (const auto& e : Spellings) {
+        const auto kana = detail::convertRomajiToKana(e.romaji, e.script);
+        if (kana != e.kana) {
+            std::cout << e.romaji << ": expected " << e.kana << ", got "
+                      << kana << std::endl;
+            ++failed;
+        }
+    }
+    return failed ? 1 : 0;
+}
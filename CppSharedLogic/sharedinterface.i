@@ -4,10 +4,32 @@
 %include "std_string.i"
 %include "std_wstring.i"
 %include "stdint.i"
+%include "arrays_java.i"
 
 %template(WStringVector) std::vector<std::wstring>;
 
+// store ids are plain numbers on the java side
+namespace detail {
+    typedef uint32_t VocabularyId;
+}
+
+// SearchResult::copyIds fills a java int[] in one call
+%apply int[] { int32_t* ids };
+
+// e.g. an unknown store id, becomes an IndexOutOfBoundsException
+%exception {
+    try {
+        $action
+    } catch (const std::out_of_range& e) {
+        SWIG_JavaThrowException(jenv, SWIG_JavaIndexOutOfBoundsException,
+                                e.what());
+        return $null;
+    }
+}
+
 %{
+#include <stdexcept>
+
 #include "sharedlogic.h"
 %}
 
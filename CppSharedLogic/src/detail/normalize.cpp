@@ -0,0 +1,92 @@
+#include "detail/normalize.h"
+
+namespace detail {
+
+    namespace {
+        enum class CharClass { Word, Dropped, Separator };
+
+        CharClass classify(char c) {
+            const auto u = static_cast<unsigned char>(c);
+            // utf-8 sequences are part of the word
+            if (u >= 0x80 || (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z') ||
+                (u >= 'A' && u <= 'Z')) {
+                return CharClass::Word;
+            }
+            return u == '\'' ? CharClass::Dropped : CharClass::Separator;
+        }
+
+        // position behind the ')' closing the '(' at 'pos',
+        // npos if it is never closed
+        size_t skipParentheses(std::string_view english, size_t pos) {
+            size_t depth = 0;
+            for (; pos < english.size(); ++pos) {
+                if (english[pos] == '(')
+                    ++depth;
+                else if (english[pos] == ')' && --depth == 0)
+                    return pos + 1;
+            }
+            return std::string_view::npos;
+        }
+    } // namespace
+
+    void appendNormalizedEnglish(std::string_view english, std::string& out) {
+        const auto first = out.size();
+        bool separate = false;
+        for (size_t pos = 0; pos < english.size();) {
+            if (english[pos] == '(') {
+                const auto end = skipParentheses(english, pos);
+                // an unclosed '(' is a separator like any other
+                if (end != std::string_view::npos) {
+                    separate = true;
+                    pos = end;
+                    continue;
+                }
+            }
+
+            const auto c = english[pos++];
+            switch (classify(c)) {
+            case CharClass::Word:
+                if (separate && out.size() != first)
+                    out += ' ';
+                separate = false;
+                out += (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+                break;
+            case CharClass::Dropped:
+                break;
+            case CharClass::Separator:
+                separate = true;
+                break;
+            }
+        }
+    }
+
+    bool isNormalizedEnglish(std::string_view english) {
+        if (english.empty())
+            return true;
+        if (english.front() == ' ' || english.back() == ' ')
+            return false;
+
+        for (size_t pos = 0; pos < english.size(); ++pos) {
+            const auto c = english[pos];
+            if (c == ' ') {
+                if (english[pos + 1] == ' ')
+                    return false;
+            } else if (classify(c) != CharClass::Word ||
+                       (c >= 'A' && c <= 'Z')) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::string_view normalizeEnglish(std::string_view english,
+                                      std::string& buffer) {
+        if (isNormalizedEnglish(english))
+            return english;
+
+        buffer.clear();
+        appendNormalizedEnglish(english, buffer);
+        return buffer;
+    }
+
+} // namespace detail
@@ -0,0 +1,85 @@
+#include "detail/querycache.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace detail {
+
+    size_t QueryCache::KeyHash::operator()(const Key& key) const {
+        const std::hash<std::string_view> hash;
+        return (hash(key.query) * 31 + size_t(key.kind)) * 31 +
+               size_t(key.parameter);
+    }
+
+    QueryCache::QueryCache(size_t capacity)
+        : m_ShardCapacity(std::max<size_t>(capacity / ShardCount, 1)) {}
+
+    QueryCache::Shard& QueryCache::_shard(const Key& key) {
+        // the upper bits, the lower ones pick the bucket inside the shard
+        const auto hash = KeyHash()(key);
+        return this->m_Shards[(hash >> 16) % ShardCount];
+    }
+
+    std::optional<std::wstring> QueryCache::find(const Key& key,
+                                                 uint64_t generation) {
+        auto& shard = this->_shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.generation != generation) {
+            shard.clear();
+            shard.generation = generation;
+        }
+
+        const auto iter = shard.index.find(key);
+        if (iter == shard.index.end()) {
+            this->m_Misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        this->m_Hits.fetch_add(1, std::memory_order_relaxed);
+        shard.entries.splice(shard.entries.begin(), shard.entries,
+                             iter->second);
+        return iter->second->value;
+    }
+
+    void QueryCache::insert(const Key& key, std::wstring value,
+                            uint64_t generation) {
+        auto& shard = this->_shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        // computed for an outdated generation
+        if (shard.generation != generation)
+            return;
+
+        // another thread may have been faster
+        if (const auto iter = shard.index.find(key);
+            iter != shard.index.end()) {
+            shard.entries.splice(shard.entries.begin(), shard.entries,
+                                 iter->second);
+            return;
+        }
+
+        if (shard.entries.size() == this->m_ShardCapacity) {
+            shard.index.erase(shard.entries.back().key());
+            shard.entries.pop_back();
+        }
+        shard.entries.push_front({key.kind, key.parameter,
+                                  std::string(key.query), std::move(value)});
+        shard.index.emplace(shard.entries.front().key(),
+                            shard.entries.begin());
+    }
+
+    void QueryCache::clear() {
+        for (auto& shard : this->m_Shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.clear();
+        }
+    }
+
+    size_t QueryCache::size() const {
+        size_t size = 0;
+        for (const auto& shard : this->m_Shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += shard.entries.size();
+        }
+        return size;
+    }
+
+} // namespace detail
@@ -0,0 +1,535 @@
+#include "detail/romaji.h"
+
+#include <array>
+#include <limits>
+
+#include "detail/transcode.h"
+
+namespace detail {
+
+    namespace romaji {
+
+        enum class Direction { Both, ToKana, ToRomaji };
+
+        struct Transliteration {
+            std::string_view romaji;
+            std::string_view kana; // hiragana
+            Direction direction = Direction::Both;
+        };
+
+        // hepburn first, aliases only used for input afterwards
+        static constexpr const Transliteration Table[] = {
+            {"a", u8"あ"}, {"i", u8"い"}, {"u", u8"う"}, {"e", u8"え"},
+            {"o", u8"お"},
+            {"ka", u8"か"}, {"ki", u8"き"}, {"ku", u8"く"}, {"ke", u8"け"},
+            {"ko", u8"こ"},
+            {"ga", u8"が"}, {"gi", u8"ぎ"}, {"gu", u8"ぐ"}, {"ge", u8"げ"},
+            {"go", u8"ご"},
+            {"sa", u8"さ"}, {"shi", u8"し"}, {"su", u8"す"}, {"se", u8"せ"},
+            {"so", u8"そ"},
+            {"za", u8"ざ"}, {"ji", u8"じ"}, {"zu", u8"ず"}, {"ze", u8"ぜ"},
+            {"zo", u8"ぞ"},
+            {"ta", u8"た"}, {"chi", u8"ち"}, {"tsu", u8"つ"}, {"te", u8"て"},
+            {"to", u8"と"},
+            {"da", u8"だ"}, {"ji", u8"ぢ", Direction::ToRomaji},
+            {"zu", u8"づ", Direction::ToRomaji}, {"de", u8"で"},
+            {"do", u8"ど"},
+            {"na", u8"な"}, {"ni", u8"に"}, {"nu", u8"ぬ"}, {"ne", u8"ね"},
+            {"no", u8"の"},
+            {"ha", u8"は"}, {"hi", u8"ひ"}, {"fu", u8"ふ"}, {"he", u8"へ"},
+            {"ho", u8"ほ"},
+            {"ba", u8"ば"}, {"bi", u8"び"}, {"bu", u8"ぶ"}, {"be", u8"べ"},
+            {"bo", u8"ぼ"},
+            {"pa", u8"ぱ"}, {"pi", u8"ぴ"}, {"pu", u8"ぷ"}, {"pe", u8"ぺ"},
+            {"po", u8"ぽ"},
+            {"ma", u8"ま"}, {"mi", u8"み"}, {"mu", u8"む"}, {"me", u8"め"},
+            {"mo", u8"も"},
+            {"ya", u8"や"}, {"yu", u8"ゆ"}, {"yo", u8"よ"},
+            {"ra", u8"ら"}, {"ri", u8"り"}, {"ru", u8"る"}, {"re", u8"れ"},
+            {"ro", u8"ろ"},
+            {"wa", u8"わ"}, {"wi", u8"ゐ", Direction::ToRomaji},
+            {"we", u8"ゑ", Direction::ToRomaji}, {"wo", u8"を"},
+            {"n", u8"ん"}, {"vu", u8"ゔ"},
+
+            // yoon
+            {"kya", u8"きゃ"}, {"kyu", u8"きゅ"}, {"kyo", u8"きょ"},
+            {"gya", u8"ぎゃ"}, {"gyu", u8"ぎゅ"}, {"gyo", u8"ぎょ"},
+            {"sha", u8"しゃ"}, {"shu", u8"しゅ"}, {"sho", u8"しょ"},
+            {"ja", u8"じゃ"}, {"ju", u8"じゅ"}, {"jo", u8"じょ"},
+            {"cha", u8"ちゃ"}, {"chu", u8"ちゅ"}, {"cho", u8"ちょ"},
+            {"ja", u8"ぢゃ", Direction::ToRomaji},
+            {"ju", u8"ぢゅ", Direction::ToRomaji},
+            {"jo", u8"ぢょ", Direction::ToRomaji},
+            {"nya", u8"にゃ"}, {"nyu", u8"にゅ"}, {"nyo", u8"にょ"},
+            {"hya", u8"ひゃ"}, {"hyu", u8"ひゅ"}, {"hyo", u8"ひょ"},
+            {"bya", u8"びゃ"}, {"byu", u8"びゅ"}, {"byo", u8"びょ"},
+            {"pya", u8"ぴゃ"}, {"pyu", u8"ぴゅ"}, {"pyo", u8"ぴょ"},
+            {"mya", u8"みゃ"}, {"myu", u8"みゅ"}, {"myo", u8"みょ"},
+            {"rya", u8"りゃ"}, {"ryu", u8"りゅ"}, {"ryo", u8"りょ"},
+
+            // extensions for loanwords
+            {"she", u8"しぇ"}, {"je", u8"じぇ"}, {"che", u8"ちぇ"},
+            {"ti", u8"てぃ"}, {"di", u8"でぃ"}, {"tu", u8"とぅ"},
+            {"du", u8"どぅ"}, {"dyu", u8"でゅ"}, {"ye", u8"いぇ"},
+            {"fa", u8"ふぁ"}, {"fi", u8"ふぃ"}, {"fe", u8"ふぇ"},
+            {"fo", u8"ふぉ"}, {"fyu", u8"ふゅ"},
+            {"wi", u8"うぃ"}, {"we", u8"うぇ"},
+            {"wo", u8"うぉ", Direction::ToRomaji},
+            {"va", u8"ゔぁ"}, {"vi", u8"ゔぃ"}, {"ve", u8"ゔぇ"},
+            {"vo", u8"ゔぉ"},
+            {"tsa", u8"つぁ"}, {"tsi", u8"つぃ"}, {"tse", u8"つぇ"},
+            {"tso", u8"つぉ"},
+
+            // small kana on their own
+            {"xa", u8"ぁ"}, {"xi", u8"ぃ"}, {"xu", u8"ぅ"}, {"xe", u8"ぇ"},
+            {"xo", u8"ぉ"}, {"xya", u8"ゃ"}, {"xyu", u8"ゅ"}, {"xyo", u8"ょ"},
+            {"xtsu", u8"っ"}, {"xwa", u8"ゎ"}, {"xka", u8"ゕ"},
+            {"xke", u8"ゖ"},
+
+            // input only spellings
+            {"si", u8"し", Direction::ToKana},
+            {"zi", u8"じ", Direction::ToKana},
+            {"hu", u8"ふ", Direction::ToKana},
+            {"sya", u8"しゃ", Direction::ToKana},
+            {"syu", u8"しゅ", Direction::ToKana},
+            {"syo", u8"しょ", Direction::ToKana},
+            {"zya", u8"じゃ", Direction::ToKana},
+            {"zyu", u8"じゅ", Direction::ToKana},
+            {"zyo", u8"じょ", Direction::ToKana},
+            {"jya", u8"じゃ", Direction::ToKana},
+            {"jyu", u8"じゅ", Direction::ToKana},
+            {"jyo", u8"じょ", Direction::ToKana},
+            {"tya", u8"ちゃ", Direction::ToKana},
+            {"tyu", u8"ちゅ", Direction::ToKana},
+            {"tyo", u8"ちょ", Direction::ToKana},
+            {"la", u8"ぁ", Direction::ToKana},
+            {"li", u8"ぃ", Direction::ToKana},
+            {"lu", u8"ぅ", Direction::ToKana},
+            {"le", u8"ぇ", Direction::ToKana},
+            {"lo", u8"ぉ", Direction::ToKana},
+            {"lya", u8"ゃ", Direction::ToKana},
+            {"lyu", u8"ゅ", Direction::ToKana},
+            {"lyo", u8"ょ", Direction::ToKana},
+            {"ltsu", u8"っ", Direction::ToKana},
+            {"xtu", u8"っ", Direction::ToKana},
+            {"ltu", u8"っ", Direction::ToKana},
+        };
+        static constexpr const size_t TableSize = std::size(Table);
+
+        static constexpr const char32_t HiraganaFirst = U'ぁ';
+        static constexpr const char32_t HiraganaLast = U'ゖ';
+        static constexpr const char32_t KatakanaFirst = U'ァ';
+        static constexpr const char32_t KatakanaLast = U'ヶ';
+        static constexpr const char32_t KatakanaOffset =
+            KatakanaFirst - HiraganaFirst;
+        static constexpr const char32_t LongVowelMark = U'ー';
+        static constexpr const size_t HiraganaCount =
+            HiraganaLast - HiraganaFirst + 1;
+
+        constexpr char32_t decode(std::string_view str, size_t& pos) {
+            const auto lead = static_cast<unsigned char>(str[pos++]);
+            if (lead < 0x80)
+                return lead;
+            size_t length = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : 1;
+            char32_t cp = lead & (0x3F >> length);
+            for (; length > 0; --length) {
+                const auto c = static_cast<unsigned char>(str[pos++]);
+                cp = (cp << 6) | (c & 0x3F);
+            }
+            return cp;
+        }
+
+        // index within the small kana following a yoon or extension,
+        // -1 for all other characters
+        constexpr int smallIndex(char32_t hiragana) {
+            constexpr const char32_t small[] = {
+                U'ぁ', U'ぃ', U'ぅ', U'ぇ', U'ぉ', U'ゃ', U'ゅ', U'ょ', U'ゎ'};
+            for (size_t i = 0; i < std::size(small); ++i) {
+                if (small[i] == hiragana)
+                    return int(i);
+            }
+            return -1;
+        }
+        static constexpr const size_t SmallCount = 9;
+
+        // kana -> romaji, at most two characters are looked at
+        struct KanaAutomaton {
+            std::array<std::string_view, HiraganaCount> single{};
+            std::array<std::array<std::string_view, SmallCount>, HiraganaCount>
+                pair{};
+        };
+
+        constexpr KanaAutomaton buildKanaAutomaton() {
+            KanaAutomaton automaton;
+            for (const auto& e : Table) {
+                if (e.direction == Direction::ToKana)
+                    continue;
+                size_t pos = 0;
+                const auto first = decode(e.kana, pos) - HiraganaFirst;
+                if (pos == e.kana.size()) {
+                    if (automaton.single[first].empty())
+                        automaton.single[first] = e.romaji;
+                    continue;
+                }
+                const auto second = smallIndex(decode(e.kana, pos));
+                if (automaton.pair[first][size_t(second)].empty())
+                    automaton.pair[first][size_t(second)] = e.romaji;
+            }
+            return automaton;
+        }
+        static constexpr const KanaAutomaton KanaToRomaji =
+            buildKanaAutomaton();
+
+        // romaji -> kana, trie over the lower case letters
+        struct RomajiAutomaton {
+            struct Output {
+                // utf-8 of one or two kana
+                std::array<char, 8> hiragana{};
+                std::array<char, 8> katakana{};
+                uint8_t size = 0;
+            };
+            struct Node {
+                std::array<uint16_t, 26> next{};
+                // index + 1 into 'outputs', 0 if no romaji ends here
+                uint16_t output = 0;
+            };
+            static constexpr const size_t MaxNodes = 512;
+
+            std::array<Output, TableSize> outputs{};
+            std::array<Node, MaxNodes> nodes{};
+            size_t nodeCount = 1;
+        };
+
+        constexpr void encode(char32_t cp, std::array<char, 8>& out,
+                              uint8_t& size) {
+            // kana are always three bytes
+            out[size++] = char(0xE0 | (cp >> 12));
+            out[size++] = char(0x80 | ((cp >> 6) & 0x3F));
+            out[size++] = char(0x80 | (cp & 0x3F));
+        }
+
+        constexpr RomajiAutomaton buildRomajiAutomaton() {
+            RomajiAutomaton automaton;
+            for (size_t i = 0; i < TableSize; ++i) {
+                const auto& e = Table[i];
+                if (e.direction == Direction::ToRomaji)
+                    continue;
+
+                size_t node = 0;
+                for (const auto c : e.romaji) {
+                    auto& next = automaton.nodes[node].next[size_t(c - 'a')];
+                    if (next == 0)
+                        next = uint16_t(automaton.nodeCount++);
+                    node = next;
+                }
+                // the first spelling wins
+                if (automaton.nodes[node].output != 0)
+                    continue;
+                automaton.nodes[node].output = uint16_t(i + 1);
+
+                auto& output = automaton.outputs[i];
+                uint8_t katakanaSize = 0;
+                for (size_t pos = 0; pos < e.kana.size();) {
+                    const auto cp = decode(e.kana, pos);
+                    encode(cp, output.hiragana, output.size);
+                    encode(cp + KatakanaOffset, output.katakana,
+                           katakanaSize);
+                }
+            }
+            return automaton;
+        }
+        static constexpr const RomajiAutomaton RomajiToKana =
+            buildRomajiAutomaton();
+        static_assert(RomajiToKana.nodeCount <= RomajiAutomaton::MaxNodes);
+
+        inline bool isVowel(char c) {
+            return c == 'a' || c == 'i' || c == 'u' || c == 'e' || c == 'o';
+        }
+
+        inline char32_t toHiragana(char32_t cp) {
+            return (cp >= KatakanaFirst && cp <= KatakanaLast)
+                       ? cp - KatakanaOffset
+                       : cp;
+        }
+
+        // ascii letters lower case, macron vowels become the vowel followed
+        // by 'Macron', everything else stays as it is
+        static constexpr const char Macron = '\x01';
+
+        static void normalizeRomaji(std::string_view romaji,
+                                    std::string& out) {
+            out.clear();
+            for (size_t pos = 0; pos < romaji.size();) {
+                const auto c = romaji[pos];
+                if (static_cast<unsigned char>(c) < 0x80) {
+                    out += (c >= 'A' && c <= 'Z') ? char(c + ('a' - 'A')) : c;
+                    ++pos;
+                    continue;
+                }
+                const auto begin = pos;
+                switch (nextUtf8CodePoint(romaji, pos)) {
+                case U'ā': case U'Ā': case U'â': case U'Â':
+                    out += "a\x01";
+                    break;
+                case U'ī': case U'Ī': case U'î': case U'Î':
+                    out += "i\x01";
+                    break;
+                case U'ū': case U'Ū': case U'û': case U'Û':
+                    out += "u\x01";
+                    break;
+                case U'ē': case U'Ē': case U'ê': case U'Ê':
+                    out += "e\x01";
+                    break;
+                case U'ō': case U'Ō': case U'ô': case U'Ô':
+                    out += "o\x01";
+                    break;
+                default:
+                    out.append(romaji.substr(begin, pos - begin));
+                    break;
+                }
+            }
+        }
+
+        static void appendRomajiToKana(std::string_view romaji,
+                                       std::string& out, KanaScript script,
+                                       std::string& normalized) {
+            normalizeRomaji(romaji, normalized);
+            const std::string_view text = normalized;
+            const bool katakana = script == KanaScript::Katakana;
+            auto append = [&](char32_t hiragana) {
+                appendUtf8CodePoint(
+                    katakana ? hiragana + KatakanaOffset : hiragana, out);
+            };
+
+            for (size_t pos = 0; pos < text.size();) {
+                const auto c = text[pos];
+                if (c == '-') {
+                    appendUtf8CodePoint(LongVowelMark, out);
+                    ++pos;
+                    continue;
+                }
+                if (c == Macron) {
+                    // ō is written おう, the other vowels are doubled
+                    const auto vowel = pos > 0 ? text[pos - 1] : 'a';
+                    if (katakana)
+                        appendUtf8CodePoint(LongVowelMark, out);
+                    else
+                        append(vowel == 'o'   ? U'う'
+                               : vowel == 'a' ? U'あ'
+                               : vowel == 'i' ? U'い'
+                               : vowel == 'u' ? U'う'
+                                              : U'え');
+                    ++pos;
+                    continue;
+                }
+                if (c < 'a' || c > 'z') {
+                    out += c;
+                    ++pos;
+                    continue;
+                }
+
+                // sokuon, a doubled consonant or 't' in front of "ch"
+                const auto next = pos + 1 < text.size() ? text[pos + 1] : 0;
+                if (!isVowel(c) && c != 'n' &&
+                    (next == c ||
+                     (c == 't' && next == 'c' && pos + 2 < text.size() &&
+                      text[pos + 2] == 'h'))) {
+                    append(U'っ');
+                    ++pos;
+                    continue;
+                }
+
+                // ime spelling nn is one ん, in front of a vowel it is
+                // ん followed by な, に, ... (onna, konnichiha)
+                if (c == 'n' && next == 'n') {
+                    const auto after =
+                        pos + 2 < text.size() ? text[pos + 2] : 0;
+                    if (!isVowel(after)) {
+                        append(U'ん');
+                        pos += after == '\'' ? 3 : 2;
+                        continue;
+                    }
+                }
+
+                // longest match
+                size_t node = 0;
+                size_t length = 0;
+                uint16_t output = 0;
+                for (size_t i = pos; i < text.size(); ++i) {
+                    if (text[i] < 'a' || text[i] > 'z')
+                        break;
+                    node = RomajiToKana.nodes[node].next[size_t(text[i] - 'a')];
+                    if (node == 0)
+                        break;
+                    if (RomajiToKana.nodes[node].output != 0) {
+                        output = RomajiToKana.nodes[node].output;
+                        length = i - pos + 1;
+                    }
+                }
+                if (output == 0) {
+                    out += c;
+                    ++pos;
+                    continue;
+                }
+
+                const auto& kana = RomajiToKana.outputs[output - 1];
+                out.append(katakana ? kana.katakana.data()
+                                    : kana.hiragana.data(),
+                           kana.size);
+                pos += length;
+                // n' separates ん from a following vowel
+                if (c == 'n' && length == 1 && pos < text.size() &&
+                    text[pos] == '\'') {
+                    ++pos;
+                }
+            }
+        }
+
+    } // namespace romaji
+
+    void appendKanaToRomaji(std::string_view kana, std::string& out) {
+        using namespace romaji;
+        bool sokuon = false;
+        bool afterN = false;
+        auto appendRomaji = [&](std::string_view romaji) {
+            if (afterN && (isVowel(romaji.front()) || romaji.front() == 'y'))
+                out += '\'';
+            if (sokuon) {
+                if (romaji.front() == 'c')
+                    out += 't';
+                else if (!isVowel(romaji.front()) && romaji.front() != 'n')
+                    out += romaji.front();
+                else
+                    out += "xtsu";
+            }
+            out += romaji;
+            sokuon = false;
+            afterN = romaji == "n";
+        };
+
+        for (size_t pos = 0; pos < kana.size();) {
+            const auto begin = pos;
+            const auto cp = toHiragana(nextUtf8CodePoint(kana, pos));
+            if (cp == U'っ') {
+                if (sokuon)
+                    out += "xtsu";
+                sokuon = true;
+                afterN = false;
+                continue;
+            }
+            if (cp == LongVowelMark) {
+                // repeats the vowel of the previous syllable
+                if (sokuon)
+                    out += "xtsu";
+                if (!out.empty() && isVowel(out.back()))
+                    out += out.back();
+                else
+                    out += '-';
+                sokuon = afterN = false;
+                continue;
+            }
+
+            std::string_view romaji;
+            if (cp >= HiraganaFirst && cp <= HiraganaLast) {
+                const auto idx = cp - HiraganaFirst;
+                size_t nextPos = pos;
+                if (pos < kana.size()) {
+                    const auto next =
+                        toHiragana(nextUtf8CodePoint(kana, nextPos));
+                    const auto small = smallIndex(next);
+                    if (small >= 0)
+                        romaji = KanaToRomaji.pair[idx][size_t(small)];
+                }
+                if (!romaji.empty())
+                    pos = nextPos;
+                else
+                    romaji = KanaToRomaji.single[idx];
+            }
+            if (romaji.empty()) {
+                if (sokuon)
+                    out += "xtsu";
+                sokuon = afterN = false;
+                out.append(kana.substr(begin, pos - begin));
+                continue;
+            }
+            appendRomaji(romaji);
+        }
+        if (sokuon)
+            out += "xtsu";
+    }
+
+    void appendRomajiToKana(std::string_view romaji, std::string& out,
+                            KanaScript script) {
+        std::string normalized;
+        romaji::appendRomajiToKana(romaji, out, script, normalized);
+    }
+
+    std::string convertKanaToRomaji(std::string_view kana) {
+        std::string result;
+        result.reserve(kana.size());
+        appendKanaToRomaji(kana, result);
+        return result;
+    }
+
+    std::string convertRomajiToKana(std::string_view romaji,
+                                    KanaScript script) {
+        std::string result;
+        result.reserve(romaji.size() * 2);
+        appendRomajiToKana(romaji, result, script);
+        return result;
+    }
+
+    void convertKanaToRomaji(const std::vector<std::string_view>& kana,
+                             std::string& out, std::vector<uint32_t>& offsets) {
+        out.clear();
+        offsets.clear();
+        offsets.reserve(kana.size() + 1);
+        offsets.push_back(0);
+        for (const auto e : kana) {
+            appendKanaToRomaji(e, out);
+            offsets.push_back(uint32_t(out.size()));
+        }
+    }
+
+    void convertRomajiToKana(const std::vector<std::string_view>& romaji,
+                             std::string& out, std::vector<uint32_t>& offsets,
+                             KanaScript script) {
+        out.clear();
+        offsets.clear();
+        offsets.reserve(romaji.size() + 1);
+        offsets.push_back(0);
+        // one normalization buffer for all of them
+        std::string normalized;
+        for (const auto e : romaji) {
+            romaji::appendRomajiToKana(e, out, script, normalized);
+            offsets.push_back(uint32_t(out.size()));
+        }
+    }
+
+    bool isRomaji(std::string_view text) {
+        bool letter = false;
+        for (size_t pos = 0; pos < text.size();) {
+            const auto c = nextUtf8CodePoint(text, pos);
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                letter = true;
+                continue;
+            }
+            switch (c) {
+            case U'ā': case U'ī': case U'ū': case U'ē': case U'ō':
+            case U'Ā': case U'Ī': case U'Ū': case U'Ē': case U'Ō':
+            case U'â': case U'î': case U'û': case U'ê': case U'ô':
+            case U'Â': case U'Î': case U'Û': case U'Ê': case U'Ô':
+                letter = true;
+                break;
+            case U'\'':
+            case U'-':
+            case U' ':
+                break;
+            default:
+                return false;
+            }
+        }
+        return letter;
+    }
+
+} // namespace detail
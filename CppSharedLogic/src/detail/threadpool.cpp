@@ -0,0 +1,48 @@
+#include "detail/threadpool.h"
+
+#include <algorithm>
+
+namespace detail::util {
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    threadCount = std::max<size_t>(threadCount, 1);
+    this->m_Threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i)
+        this->m_Threads.emplace_back([this]() { this->_run(); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(this->m_Mutex);
+        this->m_Stop = true;
+    }
+    this->m_Condition.notify_all();
+    for (auto& e : this->m_Threads)
+        e.join();
+}
+
+size_t ThreadPool::DefaultThreadCount() {
+    return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+size_t ThreadPool::size() const { return this->m_Threads.size(); }
+
+void ThreadPool::_run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(this->m_Mutex);
+            this->m_Condition.wait(lock, [this]() {
+                return this->m_Stop || !this->m_Tasks.empty();
+            });
+            if (this->m_Tasks.empty())
+                return;
+
+            task = std::move(this->m_Tasks.front());
+            this->m_Tasks.pop();
+        }
+        task();
+    }
+}
+
+}
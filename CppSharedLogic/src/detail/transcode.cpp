@@ -0,0 +1,258 @@
+#include "detail/transcode.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace detail {
+
+    namespace transcode {
+
+        static constexpr const char32_t Replacement = 0xFFFD;
+
+        // number of leading ascii bytes, checked 16 (or 8) bytes at once
+        static size_t asciiPrefix(const unsigned char* data, size_t size) {
+            size_t pos = 0;
+#if defined(__SSE2__)
+            for (; pos + 16 <= size; pos += 16) {
+                const auto block = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(data + pos));
+                if (const int mask = _mm_movemask_epi8(block); mask != 0)
+                    return pos + size_t(__builtin_ctz(unsigned(mask)));
+            }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+            for (; pos + 16 <= size; pos += 16) {
+                if (vmaxvq_u8(vld1q_u8(data + pos)) >= 0x80)
+                    break;
+            }
+#else
+            for (; pos + 8 <= size; pos += 8) {
+                uint64_t block;
+                std::memcpy(&block, data + pos, sizeof(block));
+                if (block & 0x8080808080808080ull)
+                    break;
+            }
+#endif
+            while (pos < size && data[pos] < 0x80)
+                ++pos;
+            return pos;
+        }
+
+        // widens pure ascii, 'out' has to provide space for 'size' chars
+        static void widenAscii(const unsigned char* data, size_t size,
+                               wchar_t* out) {
+            size_t pos = 0;
+#if defined(__SSE2__)
+            if constexpr (sizeof(wchar_t) == 4) {
+                const auto zero = _mm_setzero_si128();
+                for (; pos + 16 <= size; pos += 16) {
+                    const auto block = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(data + pos));
+                    const auto lo = _mm_unpacklo_epi8(block, zero);
+                    const auto hi = _mm_unpackhi_epi8(block, zero);
+                    const auto dst = reinterpret_cast<__m128i*>(out + pos);
+                    _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(lo, zero));
+                    _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+                    _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+                    _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+                }
+            }
+#endif
+            for (; pos < size; ++pos)
+                out[pos] = wchar_t(data[pos]);
+        }
+
+        // number of leading wide chars below 0x80
+        static size_t asciiPrefix(const wchar_t* data, size_t size) {
+            size_t pos = 0;
+#if defined(__SSE2__)
+            if constexpr (sizeof(wchar_t) == 4) {
+                const auto mask = _mm_set1_epi32(~0x7F);
+                const auto zero = _mm_setzero_si128();
+                for (; pos + 4 <= size; pos += 4) {
+                    const auto block = _mm_loadu_si128(
+                        reinterpret_cast<const __m128i*>(data + pos));
+                    const auto nonAscii = _mm_and_si128(block, mask);
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi32(nonAscii, zero)) !=
+                        0xFFFF) {
+                        break;
+                    }
+                }
+            }
+#endif
+            while (pos < size && uint32_t(data[pos]) < 0x80)
+                ++pos;
+            return pos;
+        }
+
+        // narrows pure ascii, 'out' has to provide space for 'size' chars
+        static void narrowAscii(const wchar_t* data, size_t size, char* out) {
+            size_t pos = 0;
+#if defined(__SSE2__)
+            if constexpr (sizeof(wchar_t) == 4) {
+                for (; pos + 16 <= size; pos += 16) {
+                    const auto src = reinterpret_cast<const __m128i*>(data + pos);
+                    const auto lo = _mm_packs_epi32(_mm_loadu_si128(src + 0),
+                                                    _mm_loadu_si128(src + 1));
+                    const auto hi = _mm_packs_epi32(_mm_loadu_si128(src + 2),
+                                                    _mm_loadu_si128(src + 3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + pos),
+                                     _mm_packus_epi16(lo, hi));
+                }
+            }
+#endif
+            for (; pos < size; ++pos)
+                out[pos] = char(data[pos]);
+        }
+
+        // decodes a single non ascii code point starting at 'pos',
+        // overlong forms, surrogates and truncated sequences are invalid
+        static char32_t decode(const unsigned char* data, size_t size,
+                               size_t& pos) {
+            const unsigned char lead = data[pos++];
+            size_t length = 0;
+            char32_t cp = 0;
+            char32_t min = 0;
+            if (lead >= 0xC2 && lead <= 0xDF) {
+                length = 1;
+                cp = lead & 0x1F;
+                min = 0x80;
+            } else if (lead >= 0xE0 && lead <= 0xEF) {
+                length = 2;
+                cp = lead & 0x0F;
+                min = 0x800;
+            } else if (lead >= 0xF0 && lead <= 0xF4) {
+                length = 3;
+                cp = lead & 0x07;
+                min = 0x10000;
+            } else
+                return Replacement;
+
+            for (size_t i = 0; i < length; ++i, ++pos) {
+                if (pos >= size || (data[pos] & 0xC0) != 0x80)
+                    return Replacement;
+                cp = (cp << 6) | (data[pos] & 0x3F);
+            }
+            if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+                return Replacement;
+            return cp;
+        }
+
+        static void appendWide(char32_t cp, std::wstring& out) {
+            if constexpr (sizeof(wchar_t) == 2) {
+                if (cp >= 0x10000) {
+                    cp -= 0x10000;
+                    out += wchar_t(0xD800 + (cp >> 10));
+                    out += wchar_t(0xDC00 + (cp & 0x3FF));
+                    return;
+                }
+            }
+            out += wchar_t(cp);
+        }
+
+        static char32_t readWide(const wchar_t* data, size_t size,
+                                 size_t& pos) {
+            char32_t cp = char32_t(uint32_t(data[pos++]));
+            if constexpr (sizeof(wchar_t) == 2) {
+                if (cp >= 0xD800 && cp <= 0xDBFF && pos < size &&
+                    data[pos] >= 0xDC00 && data[pos] <= 0xDFFF) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) +
+                         (char32_t(data[pos++]) - 0xDC00);
+                    return cp;
+                }
+            }
+            if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+                return Replacement;
+            return cp;
+        }
+
+        static void appendUtf8(char32_t cp, std::string& out) {
+            if (cp < 0x80) {
+                out += char(cp);
+            } else if (cp < 0x800) {
+                out += char(0xC0 | (cp >> 6));
+                out += char(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                out += char(0xE0 | (cp >> 12));
+                out += char(0x80 | ((cp >> 6) & 0x3F));
+                out += char(0x80 | (cp & 0x3F));
+            } else {
+                out += char(0xF0 | (cp >> 18));
+                out += char(0x80 | ((cp >> 12) & 0x3F));
+                out += char(0x80 | ((cp >> 6) & 0x3F));
+                out += char(0x80 | (cp & 0x3F));
+            }
+        }
+
+    } // namespace transcode
+
+    void appendUtf8ToWstring(std::string_view utf8, std::wstring& out) {
+        using namespace transcode;
+        const auto data = reinterpret_cast<const unsigned char*>(utf8.data());
+        const auto size = utf8.size();
+
+        // never more wide chars than bytes
+        out.reserve(out.size() + size);
+        for (size_t pos = 0; pos < size;) {
+            if (const auto ascii = asciiPrefix(data + pos, size - pos)) {
+                const auto offset = out.size();
+                out.resize(offset + ascii);
+                widenAscii(data + pos, ascii, &out[offset]);
+                pos += ascii;
+                continue;
+            }
+            appendWide(decode(data, size, pos), out);
+        }
+    }
+
+    void appendWstringToUtf8(std::wstring_view wide, std::string& out) {
+        using namespace transcode;
+        const auto data = wide.data();
+        const auto size = wide.size();
+
+        out.reserve(out.size() + size);
+        for (size_t pos = 0; pos < size;) {
+            if (const auto ascii = asciiPrefix(data + pos, size - pos)) {
+                const auto offset = out.size();
+                out.resize(offset + ascii);
+                narrowAscii(data + pos, ascii, &out[offset]);
+                pos += ascii;
+                continue;
+            }
+            appendUtf8(readWide(data, size, pos), out);
+        }
+    }
+
+    std::wstring convertUtf8Wstring(std::string_view str) {
+        std::wstring result;
+        appendUtf8ToWstring(str, result);
+        return result;
+    }
+
+    std::string convertWstringUtf8(std::wstring_view str) {
+        std::string result;
+        appendWstringToUtf8(str, result);
+        return result;
+    }
+
+    char32_t nextUtf8CodePoint(std::string_view utf8, size_t& pos) {
+        const auto data = reinterpret_cast<const unsigned char*>(utf8.data());
+        if (data[pos] < 0x80)
+            return data[pos++];
+
+        return transcode::decode(data, utf8.size(), pos);
+    }
+
+    void appendUtf8CodePoint(char32_t cp, std::string& out) {
+        if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+            cp = transcode::Replacement;
+
+        transcode::appendUtf8(cp, out);
+    }
+
+} // namespace detail
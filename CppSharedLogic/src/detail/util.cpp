@@ -1,5 +1,10 @@
 #include "detail/util.hpp"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace detail::util {
 
 size_t getRandomIndex(size_t max) {
@@ -13,4 +18,33 @@ std::mt19937& GetRandomGenerator() {
     return mersenne;
 }
 
+MemoryMappedFile::MemoryMappedFile(const std::string& filepath) {
+    const int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* ptr = ::mmap(nullptr, size_t(info.st_size), PROT_READ,
+                           MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+            this->m_Data = static_cast<const char*>(ptr);
+            this->m_Size = size_t(info.st_size);
+        }
+    }
+    // the mapping stays valid after closing the descriptor
+    ::close(fd);
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+    if (this->m_Data)
+        ::munmap(const_cast<char*>(this->m_Data), this->m_Size);
+}
+
+void MemoryMappedFile::adviseSequential() const {
+    if (this->m_Data)
+        (void)::posix_madvise(const_cast<char*>(this->m_Data), this->m_Size,
+                              POSIX_MADV_SEQUENTIAL);
+}
+
 }
@@ -0,0 +1,261 @@
+#include "detail/vocabfilter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "detail/transcode.h"
+
+namespace detail {
+
+    namespace {
+        using word_type = VocabularyBitmap::word_type;
+        constexpr const size_t WordBits = VocabularyBitmap::WordBits;
+
+        inline unsigned countBits(word_type word) {
+            return unsigned(__builtin_popcountll(word));
+        }
+        inline unsigned lowestBit(word_type word) {
+            return unsigned(__builtin_ctzll(word));
+        }
+
+        // ones below 'bits', 'bits' < WordBits
+        inline word_type lowMask(size_t bits) {
+            return (word_type(1) << bits) - 1;
+        }
+
+        bool isKatakana(char32_t cp) {
+            // includes ・ and ー
+            return cp >= 0x30A0 && cp <= 0x30FF;
+        }
+
+        template <typename _Predicate>
+        bool anyCodePoint(std::string_view utf8, _Predicate&& predicate) {
+            for (size_t pos = 0; pos < utf8.size();) {
+                if (predicate(nextUtf8CodePoint(utf8, pos)))
+                    return true;
+            }
+            return false;
+        }
+    } // namespace
+
+    VocabularyBitmap::VocabularyBitmap(size_t size)
+        : m_Size(size), m_Words((size + WordBits - 1) / WordBits, 0) {}
+
+    size_t VocabularyBitmap::count() const {
+        size_t count = 0;
+        for (const auto word : this->m_Words)
+            count += countBits(word);
+        return count;
+    }
+
+    bool VocabularyBitmap::test(VocabularyId id) const {
+        return (this->word(id / WordBits) >> (id % WordBits)) & 1;
+    }
+
+    void VocabularyBitmap::set(VocabularyId id) {
+        assert(id < this->m_Size);
+        this->m_Words[id / WordBits] |= word_type(1) << (id % WordBits);
+    }
+
+    void VocabularyBitmap::reset(VocabularyId id) {
+        assert(id < this->m_Size);
+        this->m_Words[id / WordBits] &= ~(word_type(1) << (id % WordBits));
+    }
+
+    void VocabularyBitmap::set(VocabularyId begin, VocabularyId end) {
+        assert(begin <= end && end <= this->m_Size);
+        if (begin == end)
+            return;
+
+        const auto first = begin / WordBits;
+        const auto last = (end - 1) / WordBits;
+        const auto head = ~lowMask(begin % WordBits);
+        const auto tail =
+            end % WordBits ? lowMask(end % WordBits) : ~word_type(0);
+        if (first == last) {
+            this->m_Words[first] |= head & tail;
+            return;
+        }
+        this->m_Words[first] |= head;
+        std::fill(this->m_Words.begin() + first + 1,
+                  this->m_Words.begin() + last, ~word_type(0));
+        this->m_Words[last] |= tail;
+    }
+
+    VocabularyQuery::VocabularyQuery(const VocabularyBitmap& bitmap)
+        : m_Root(std::make_shared<Node>(Node{Operation::Bitmap, bitmap.size(),
+                                             &bitmap, nullptr, nullptr})) {}
+
+    VocabularyQuery VocabularyQuery::_combine(Operation operation,
+                                              const VocabularyQuery& lhs,
+                                              const VocabularyQuery* rhs) {
+        const auto size =
+            rhs ? std::max(lhs.size(), rhs->size()) : lhs.size();
+        return VocabularyQuery(std::make_shared<Node>(
+            Node{operation, size, nullptr, lhs.m_Root,
+                 rhs ? rhs->m_Root : nullptr}));
+    }
+
+    VocabularyQuery operator&(const VocabularyQuery& lhs,
+                              const VocabularyQuery& rhs) {
+        return VocabularyQuery::_combine(VocabularyQuery::Operation::And, lhs,
+                                         &rhs);
+    }
+
+    VocabularyQuery operator|(const VocabularyQuery& lhs,
+                              const VocabularyQuery& rhs) {
+        return VocabularyQuery::_combine(VocabularyQuery::Operation::Or, lhs,
+                                         &rhs);
+    }
+
+    VocabularyQuery operator~(const VocabularyQuery& query) {
+        return VocabularyQuery::_combine(VocabularyQuery::Operation::Not, query,
+                                         nullptr);
+    }
+
+    void VocabularyQuery::_evaluate(const Node& node, size_t firstWord,
+                                    Block& out) {
+        // plain loops over fixed size blocks, the compiler turns
+        // them into simd instructions where available
+        switch (node.operation) {
+        case Operation::Bitmap: {
+            const auto& words = node.bitmap->words();
+            if (firstWord + BlockWords <= words.size()) {
+                std::memcpy(out.data(), words.data() + firstWord,
+                            sizeof(Block));
+                break;
+            }
+            for (size_t i = 0; i < BlockWords; ++i)
+                out[i] = node.bitmap->word(firstWord + i);
+            break;
+        }
+        case Operation::Not:
+            _evaluate(*node.lhs, firstWord, out);
+            for (auto& word : out)
+                word = ~word;
+            break;
+        case Operation::And: {
+            _evaluate(*node.lhs, firstWord, out);
+            // nothing left to intersect, common for sparse bitmaps
+            if (std::all_of(out.begin(), out.end(),
+                            [](word_type word) { return word == 0; }))
+                break;
+            Block rhs;
+            _evaluate(*node.rhs, firstWord, rhs);
+            for (size_t i = 0; i < BlockWords; ++i)
+                out[i] &= rhs[i];
+            break;
+        }
+        case Operation::Or: {
+            _evaluate(*node.lhs, firstWord, out);
+            Block rhs;
+            _evaluate(*node.rhs, firstWord, rhs);
+            for (size_t i = 0; i < BlockWords; ++i)
+                out[i] |= rhs[i];
+            break;
+        }
+        }
+    }
+
+    void VocabularyQuery::_evaluate(size_t firstWord, Block& out) const {
+        _evaluate(*this->m_Root, firstWord, out);
+
+        // a negation sets the bits past the end as well
+        const auto size = this->size();
+        for (size_t i = 0; i < BlockWords; ++i) {
+            const auto begin = (firstWord + i) * WordBits;
+            if (begin >= size)
+                out[i] = 0;
+            else if (size - begin < WordBits)
+                out[i] &= lowMask(size - begin);
+        }
+    }
+
+    size_t VocabularyQuery::count() const {
+        size_t count = 0;
+        Block block;
+        for (size_t first = 0; first * WordBits < this->size();
+             first += BlockWords) {
+            this->_evaluate(first, block);
+            for (const auto word : block)
+                count += countBits(word);
+        }
+        return count;
+    }
+
+    VocabularyBitmap VocabularyQuery::evaluate() const {
+        VocabularyBitmap result(this->size());
+        auto& words = result.m_Words;
+        Block block;
+        for (size_t first = 0; first < words.size(); first += BlockWords) {
+            this->_evaluate(first, block);
+            std::copy_n(block.begin(),
+                        std::min(BlockWords, words.size() - first),
+                        words.begin() + first);
+        }
+        return result;
+    }
+
+    VocabularyQuery::const_iterator::const_iterator(
+        const VocabularyQuery* query)
+        : m_Query(query) {
+        if (query->size() == 0) {
+            this->m_Query = nullptr;
+            return;
+        }
+        query->_evaluate(0, this->m_Block);
+        this->m_Bits = this->m_Block[0];
+        this->_next();
+    }
+
+    void VocabularyQuery::const_iterator::_next() {
+        while (this->m_Bits == 0) {
+            if (++this->m_WordIdx == BlockWords) {
+                this->m_FirstWord += BlockWords;
+                if (this->m_FirstWord * WordBits >= this->m_Query->size()) {
+                    *this = const_iterator();
+                    return;
+                }
+                this->m_Query->_evaluate(this->m_FirstWord, this->m_Block);
+                this->m_WordIdx = 0;
+            }
+            this->m_Bits = this->m_Block[this->m_WordIdx];
+        }
+        this->m_Id = VocabularyId(
+            (this->m_FirstWord + this->m_WordIdx) * WordBits +
+            lowestBit(this->m_Bits));
+        this->m_Bits &= this->m_Bits - 1;
+    }
+
+    VocabularyAttributes::VocabularyAttributes(const VocabularyStore& store) {
+        const auto segments = store.segmentCount();
+        const auto size =
+            segments ? size_t(store.getSegment(segments - 1).second.id()) : 0;
+
+        for (auto& level : this->m_Levels)
+            level = VocabularyBitmap(size);
+        this->m_HasKanji = VocabularyBitmap(size);
+        this->m_KatakanaOnly = VocabularyBitmap(size);
+
+        for (size_t i = 0; i < segments; ++i) {
+            for (size_t type = 0; type < this->m_Levels.size(); ++type) {
+                const auto [begin, end] =
+                    store.getTypeRange(i, Vocabulary::Type(type));
+                this->m_Levels[type].set(begin.id(), end.id());
+            }
+            for (auto [iter, end] = store.getSegment(i); iter != end; ++iter) {
+                const auto voc = *iter;
+                if (anyCodePoint(voc.kanji, KanjiIndex::isKanji))
+                    this->m_HasKanji.set(iter.id());
+                if (!voc.kana.empty() &&
+                    !anyCodePoint(voc.kana, [](char32_t cp) {
+                        return !isKatakana(cp);
+                    })) {
+                    this->m_KatakanaOnly.set(iter.id());
+                }
+            }
+        }
+    }
+
+} // namespace detail
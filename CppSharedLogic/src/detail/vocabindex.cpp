@@ -0,0 +1,566 @@
+#include "detail/vocabindex.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+#include <unordered_map>
+
+namespace detail {
+
+    EnglishTokenIndex::EnglishTokenIndex(const VocabularySegment& segment) {
+        // collect the unique tokens and every (vocabulary, token) pair,
+        // a vocabulary is listed only once per token
+        std::unordered_map<std::string_view, uint32_t> tokenIds;
+        std::vector<std::string_view> tokens;
+        std::vector<uint32_t> counts;
+        std::vector<VocabularyId> lastVocabulary;
+        std::vector<std::pair<VocabularyId, uint32_t>> occurrences;
+        tokenIds.reserve(segment.size());
+        occurrences.reserve(segment.size() * 2);
+
+        for (size_t i = 0; i < segment.size(); ++i) {
+            const auto id = VocabularyId(i);
+            for (const auto e : segment[i].english) {
+                forEachToken(e, [&](std::string_view token) {
+                    const auto [iter, inserted] =
+                        tokenIds.emplace(token, uint32_t(tokens.size()));
+                    if (inserted) {
+                        tokens.push_back(token);
+                        counts.push_back(0);
+                        lastVocabulary.push_back(0);
+                    }
+                    // ids are stored +1, so 0 means 'not seen yet'
+                    const auto tokenId = iter->second;
+                    if (lastVocabulary[tokenId] != id + 1) {
+                        lastVocabulary[tokenId] = id + 1;
+                        ++counts[tokenId];
+                        occurrences.emplace_back(id, tokenId);
+                    }
+                });
+            }
+        }
+
+        // sorted tokens allow a binary search on lookup
+        std::vector<uint32_t> order(tokens.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+            return tokens[lhs] < tokens[rhs];
+        });
+
+        std::vector<uint32_t> cursor(tokens.size());
+        this->m_Tokens.reserve(tokens.size());
+        this->m_PostingBegin.reserve(tokens.size() + 1);
+        this->m_PostingBegin.push_back(0);
+        for (const auto e : order) {
+            cursor[e] = this->m_PostingBegin.back();
+            this->m_Tokens.push_back(tokens[e]);
+            this->m_PostingBegin.push_back(this->m_PostingBegin.back() +
+                                           counts[e]);
+        }
+
+        // occurrences are in ascending vocabulary order,
+        // so every posting list ends up sorted
+        this->m_Postings.resize(occurrences.size());
+        for (const auto& [id, tokenId] : occurrences)
+            this->m_Postings[cursor[tokenId]++] = id;
+    }
+
+    EnglishTokenIndex::Postings
+        EnglishTokenIndex::find(std::string_view token) const {
+        const auto iter = std::lower_bound(this->m_Tokens.begin(),
+                                           this->m_Tokens.end(), token);
+        if (iter == this->m_Tokens.end() || *iter != token)
+            return {nullptr, nullptr};
+
+        const auto idx = size_t(iter - this->m_Tokens.begin());
+        const auto postings = this->m_Postings.data();
+        return {postings + this->m_PostingBegin[idx],
+                postings + this->m_PostingBegin[idx + 1]};
+    }
+
+    std::vector<VocabularyId>
+        EnglishTokenIndex::intersect(std::string_view english) const {
+        std::vector<Postings> lists;
+        bool missing = false;
+        forEachToken(english, [&](std::string_view token) {
+            const auto postings = this->find(token);
+            missing |= postings.first == postings.second;
+            lists.push_back(postings);
+        });
+        if (missing || lists.empty())
+            return {};
+
+        // start with the shortest list, the result only ever shrinks
+        std::sort(lists.begin(), lists.end(),
+                  [](const Postings& lhs, const Postings& rhs) {
+                      return lhs.second - lhs.first < rhs.second - rhs.first;
+                  });
+
+        std::vector<VocabularyId> result(lists.front().first,
+                                         lists.front().second);
+        std::vector<VocabularyId> tmp;
+        for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+            tmp.clear();
+            std::set_intersection(result.begin(), result.end(),
+                                  lists[i].first, lists[i].second,
+                                  std::back_inserter(tmp));
+            result.swap(tmp);
+        }
+        return result;
+    }
+
+    KanjiIndex::KanjiIndex(const VocabularySegment& segment) {
+        // every (kanji, vocabulary) pair once,
+        // sorting them yields the posting lists one after another
+        std::vector<std::pair<char32_t, VocabularyId>> occurrences;
+        std::vector<char32_t> kanji;
+        occurrences.reserve(segment.size() * 2);
+        for (size_t i = 0; i < segment.size(); ++i) {
+            const auto text = segment[i].kanji;
+            kanji.clear();
+            for (size_t pos = 0; pos < text.size();) {
+                const auto cp = nextUtf8CodePoint(text, pos);
+                if (isKanji(cp))
+                    kanji.push_back(cp);
+            }
+            std::sort(kanji.begin(), kanji.end());
+            kanji.erase(std::unique(kanji.begin(), kanji.end()), kanji.end());
+            for (const auto e : kanji)
+                occurrences.emplace_back(e, VocabularyId(i));
+        }
+        std::sort(occurrences.begin(), occurrences.end());
+
+        this->m_Postings.reserve(occurrences.size());
+        for (const auto& [cp, id] : occurrences) {
+            if (this->m_Kanji.empty() || this->m_Kanji.back() != cp) {
+                this->m_Kanji.push_back(cp);
+                this->m_PostingBegin.push_back(
+                    uint32_t(this->m_Postings.size()));
+            }
+            this->m_Postings.push_back(id);
+        }
+        this->m_PostingBegin.push_back(uint32_t(this->m_Postings.size()));
+    }
+
+    KanjiIndex::Postings KanjiIndex::find(char32_t kanji) const {
+        const auto iter =
+            std::lower_bound(this->m_Kanji.begin(), this->m_Kanji.end(), kanji);
+        if (iter == this->m_Kanji.end() || *iter != kanji)
+            return {nullptr, nullptr};
+
+        const auto idx = size_t(iter - this->m_Kanji.begin());
+        const auto postings = this->m_Postings.data();
+        return {postings + this->m_PostingBegin[idx],
+                postings + this->m_PostingBegin[idx + 1]};
+    }
+
+    std::vector<VocabularyId>
+        KanjiIndex::intersect(std::string_view kanji) const {
+        std::vector<Postings> lists;
+        for (size_t pos = 0; pos < kanji.size();) {
+            const auto cp = nextUtf8CodePoint(kanji, pos);
+            if (!isKanji(cp))
+                continue;
+            const auto postings = this->find(cp);
+            if (postings.first == postings.second)
+                return {};
+            lists.push_back(postings);
+        }
+        if (lists.empty())
+            return {};
+
+        // same as for the english tokens, shortest list first
+        std::sort(lists.begin(), lists.end(),
+                  [](const Postings& lhs, const Postings& rhs) {
+                      return lhs.second - lhs.first < rhs.second - rhs.first;
+                  });
+
+        std::vector<VocabularyId> result(lists.front().first,
+                                         lists.front().second);
+        std::vector<VocabularyId> tmp;
+        for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+            tmp.clear();
+            std::set_intersection(result.begin(), result.end(),
+                                  lists[i].first, lists[i].second,
+                                  std::back_inserter(tmp));
+            result.swap(tmp);
+        }
+        return result;
+    }
+
+    KanaSubstringIndex::KanaSubstringIndex(VocabularySegment segment)
+        : m_Segment(std::move(segment)) {
+        // sorted with the text next to each suffix, that avoids looking
+        // up the reading on every comparison, most comparisons are already
+        // decided by the first 8 bytes packed into an integer
+        struct SortEntry {
+            uint64_t prefix;
+            std::string_view text;
+            Suffix suffix;
+        };
+        auto packPrefix = [](std::string_view text) {
+            uint64_t prefix = 0;
+            for (size_t i = 0; i < sizeof(prefix); ++i) {
+                prefix <<= 8;
+                if (i < text.size())
+                    prefix |= static_cast<unsigned char>(text[i]);
+            }
+            return prefix;
+        };
+        std::vector<SortEntry> entries;
+        const auto& records = this->m_Segment.records();
+        for (size_t i = 0; i < this->m_Segment.size(); ++i) {
+            const auto kana = this->m_Segment.getString(records[i].kana);
+            for (size_t pos = 0; pos < kana.size(); ++pos) {
+                // skip utf-8 continuation bytes
+                if ((static_cast<unsigned char>(kana[pos]) & 0xC0) != 0x80) {
+                    const auto text = kana.substr(pos);
+                    entries.push_back({packPrefix(text), text,
+                                       {VocabularyId(i), uint32_t(pos)}});
+                }
+            }
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const SortEntry& lhs, const SortEntry& rhs) {
+                      if (lhs.prefix != rhs.prefix)
+                          return lhs.prefix < rhs.prefix;
+                      return lhs.text < rhs.text;
+                  });
+
+        this->m_Suffixes.reserve(entries.size());
+        for (const auto& e : entries)
+            this->m_Suffixes.push_back(e.suffix);
+    }
+
+    std::string_view KanaSubstringIndex::_text(const Suffix& suffix) const {
+        const auto& record = this->m_Segment.records()[suffix.id];
+        return this->m_Segment.getString(record.kana).substr(suffix.offset);
+    }
+
+    std::vector<VocabularyId>
+        KanaSubstringIndex::find(std::string_view kana, size_t limit) const {
+        assert(!kana.empty());
+        // suffixes starting with 'kana' compare equal to it
+        auto prefixLess = [&](const Suffix& suffix, std::string_view str) {
+            return this->_text(suffix).substr(0, str.size()) < str;
+        };
+        auto prefixGreater = [&](std::string_view str, const Suffix& suffix) {
+            return str < this->_text(suffix).substr(0, str.size());
+        };
+        const auto begin = std::lower_bound(this->m_Suffixes.begin(),
+                                            this->m_Suffixes.end(), kana,
+                                            prefixLess);
+        const auto end = std::upper_bound(begin, this->m_Suffixes.end(), kana,
+                                          prefixGreater);
+
+        // a reading may contain 'kana' more than once
+        // the heap below is meant for a small limit only
+        std::vector<VocabularyId> result;
+        if (limit > 256 || limit * 16 >= size_t(end - begin)) {
+            result.reserve(size_t(end - begin));
+            for (auto iter = begin; iter != end; ++iter)
+                result.push_back(iter->id);
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()),
+                         result.end());
+            if (result.size() > limit)
+                result.resize(limit);
+            return result;
+        }
+
+        // max heap of the smallest distinct ids seen so far, a duplicate
+        // can only be inserted if it is smaller than the largest one
+        result.reserve(limit);
+        for (auto iter = begin; iter != end && limit != 0; ++iter) {
+            const auto id = iter->id;
+            if (result.size() == limit && id >= result.front())
+                continue;
+            if (std::find(result.begin(), result.end(), id) != result.end())
+                continue;
+            if (result.size() == limit) {
+                std::pop_heap(result.begin(), result.end());
+                result.back() = id;
+            } else
+                result.push_back(id);
+            std::push_heap(result.begin(), result.end());
+        }
+        std::sort_heap(result.begin(), result.end());
+        return result;
+    }
+
+    namespace {
+        // only ascii letters are folded, utf-8 bytes stay as they are
+        inline unsigned char foldCase(char c) {
+            const auto u = static_cast<unsigned char>(c);
+            return (u >= 'A' && u <= 'Z') ? u + ('a' - 'A') : u;
+        }
+        inline char32_t foldCase(char32_t c) {
+            return c < 0x80 ? foldCase(char(c)) : c;
+        }
+
+        // case insensitive three way comparison
+        int compareFolded(std::string_view lhs, std::string_view rhs) {
+            const auto size = std::min(lhs.size(), rhs.size());
+            for (size_t i = 0; i < size; ++i) {
+                const auto l = foldCase(lhs[i]);
+                const auto r = foldCase(rhs[i]);
+                if (l != r)
+                    return l < r ? -1 : 1;
+            }
+            if (lhs.size() == rhs.size())
+                return 0;
+            return lhs.size() < rhs.size() ? -1 : 1;
+        }
+    } // namespace
+
+    bool CompletionIndex::startsWith(std::string_view key,
+                                     std::string_view prefix) {
+        return key.size() >= prefix.size() &&
+               compareFolded(key.substr(0, prefix.size()), prefix) == 0;
+    }
+
+    CompletionIndex::CompletionIndex(VocabularySegment segment, Keys keys)
+        : m_Segment(std::move(segment)) {
+        // same as for the suffixes, the folded first 8 bytes decide
+        // most comparisons, the id keeps the order of equal keys stable
+        struct SortEntry {
+            uint64_t prefix;
+            std::string_view text;
+            Key key;
+        };
+        std::vector<SortEntry> entries;
+        auto addKey = [&](uint32_t string, VocabularyId id) {
+            const auto text = this->m_Segment.getString(string);
+            uint64_t prefix = 0;
+            for (size_t i = 0; i < sizeof(prefix); ++i) {
+                prefix <<= 8;
+                if (i < text.size())
+                    prefix |= foldCase(text[i]);
+            }
+            entries.push_back({prefix, text, {string, id}});
+        };
+        const auto& records = this->m_Segment.records();
+        for (size_t i = 0; i < this->m_Segment.size(); ++i) {
+            const auto& record = records[i];
+            if (keys == Keys::Kana) {
+                addKey(record.kana, VocabularyId(i));
+                continue;
+            }
+            for (uint32_t e = 0; e < record.englishCount; ++e)
+                addKey(record.englishBegin + e, VocabularyId(i));
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const SortEntry& lhs, const SortEntry& rhs) {
+                      if (lhs.prefix != rhs.prefix)
+                          return lhs.prefix < rhs.prefix;
+                      const auto cmp = compareFolded(lhs.text, rhs.text);
+                      return cmp != 0 ? cmp < 0 : lhs.key.id < rhs.key.id;
+                  });
+
+        this->m_Keys.reserve(entries.size());
+        for (const auto& e : entries)
+            this->m_Keys.push_back(e.key);
+
+        // jlpt level in the upper bits, key length below
+        this->m_Ranks.reserve(this->m_Keys.size());
+        for (const auto& e : this->m_Keys) {
+            const auto length = std::min<size_t>(this->_text(e).size(),
+                                                 (1u << 24) - 1);
+            this->m_Ranks.push_back((records[e.id].type << 24) |
+                                    uint32_t(length));
+        }
+
+        const auto size = this->m_Keys.size();
+        this->m_MinTree.resize(2 * size);
+        for (size_t i = 0; i < size; ++i)
+            this->m_MinTree[size + i] = uint32_t(i);
+        for (size_t i = size; i-- > 1;)
+            this->m_MinTree[i] = uint32_t(this->_better(
+                this->m_MinTree[2 * i], this->m_MinTree[2 * i + 1]));
+    }
+
+    size_t CompletionIndex::_better(size_t lhs, size_t rhs) const {
+        if (lhs == NoKey)
+            return rhs;
+        const auto l = this->m_Ranks[lhs];
+        const auto r = this->m_Ranks[rhs];
+        if (l != r)
+            return l < r ? lhs : rhs;
+        return this->m_Keys[lhs].id <= this->m_Keys[rhs].id ? lhs : rhs;
+    }
+
+    size_t CompletionIndex::_best(size_t begin, size_t end) const {
+        const auto size = this->m_Keys.size();
+        size_t best = NoKey;
+        for (begin += size, end += size; begin < end; begin /= 2, end /= 2) {
+            if (begin & 1)
+                best = this->_better(best, this->m_MinTree[begin++]);
+            if (end & 1)
+                best = this->_better(best, this->m_MinTree[--end]);
+        }
+        return best;
+    }
+
+    std::pair<size_t, size_t>
+        CompletionIndex::equalRange(std::string_view key) const {
+        const auto keys = this->m_Keys.begin();
+        const auto begin = std::partition_point(
+            keys, this->m_Keys.end(), [&](const Key& other) {
+                return compareFolded(this->_text(other), key) < 0;
+            });
+        const auto end = std::partition_point(
+            begin, this->m_Keys.end(), [&](const Key& other) {
+                return compareFolded(this->_text(other), key) == 0;
+            });
+        return {size_t(begin - keys), size_t(end - keys)};
+    }
+
+    std::vector<CompletionIndex::Completion>
+        CompletionIndex::complete(std::string_view prefix,
+                                  size_t limit) const {
+        std::vector<Completion> result;
+        if (limit == 0)
+            return result;
+
+        // keys starting with 'prefix' are continuous,
+        // the ones equal to it are in front
+        const auto keys = this->m_Keys.begin();
+        const auto begin = std::partition_point(
+            keys, this->m_Keys.end(), [&](const Key& key) {
+                const auto text = this->_text(key);
+                return compareFolded(text.substr(0, prefix.size()), prefix) <
+                       0;
+            });
+        const auto end =
+            std::partition_point(begin, this->m_Keys.end(), [&](const Key& key) {
+                return startsWith(this->_text(key), prefix);
+            });
+        const auto exactEnd =
+            std::partition_point(begin, end, [&](const Key& key) {
+                return this->_text(key).size() == prefix.size();
+            });
+
+        // ranges ordered by their best key, the best one is split
+        // around that key after it has been taken
+        struct Range {
+            uint64_t rank;
+            size_t best, begin, end;
+            bool operator<(const Range& rhs) const {
+                return this->rank > rhs.rank;
+            }
+        };
+        std::vector<Range> heap;
+        auto push = [&](size_t begin, size_t end, bool exact) {
+            const auto best = this->_best(begin, end);
+            if (best == NoKey)
+                return;
+            const auto rank = (uint64_t(!exact) << 63) |
+                              (uint64_t(this->m_Ranks[best]) << 32) |
+                              this->m_Keys[best].id;
+            heap.push_back({rank, best, begin, end});
+            std::push_heap(heap.begin(), heap.end());
+        };
+        push(size_t(begin - keys), size_t(exactEnd - keys), true);
+        push(size_t(exactEnd - keys), size_t(end - keys), false);
+
+        while (!heap.empty() && result.size() < limit) {
+            std::pop_heap(heap.begin(), heap.end());
+            const auto range = heap.back();
+            heap.pop_back();
+
+            // a vocabulary may have several translations with this prefix
+            const auto id = this->m_Keys[range.best].id;
+            if (std::none_of(result.begin(), result.end(),
+                             [id](const Completion& c) { return c.id == id; }))
+                result.push_back({range.rank >> 32, id});
+
+            const bool exact = (range.rank >> 63) == 0;
+            push(range.begin, range.best, exact);
+            push(range.best + 1, range.end, exact);
+        }
+        return result;
+    }
+
+    std::vector<CompletionIndex::Match>
+        CompletionIndex::findSimilar(std::string_view query,
+                                     uint32_t maxDistance) const {
+        std::u32string pattern;
+        for (size_t pos = 0; pos < query.size();)
+            pattern += foldCase(nextUtf8CodePoint(query, pos));
+
+        // distances of the empty prefix
+        std::vector<uint32_t> rows(pattern.size() + 1);
+        std::iota(rows.begin(), rows.end(), 0);
+
+        std::vector<Match> result;
+        this->_findSimilar(0, this->m_Keys.size(), 0, pattern, maxDistance,
+                           rows, result);
+
+        // only the closest key of each vocabulary
+        std::sort(result.begin(), result.end(),
+                  [](const Match& lhs, const Match& rhs) {
+                      return lhs.id != rhs.id ? lhs.id < rhs.id
+                                              : lhs.distance < rhs.distance;
+                  });
+        result.erase(std::unique(result.begin(), result.end(),
+                                 [](const Match& lhs, const Match& rhs) {
+                                     return lhs.id == rhs.id;
+                                 }),
+                     result.end());
+        return result;
+    }
+
+    void CompletionIndex::_findSimilar(size_t begin, size_t end, size_t depth,
+                                       const std::u32string& query,
+                                       uint32_t maxDistance,
+                                       std::vector<uint32_t>& rows,
+                                       std::vector<Match>& result) const {
+        const auto width = query.size() + 1;
+        const auto row = rows.size() - width;
+
+        // keys ending here are sorted in front of the longer ones
+        auto iter = begin;
+        for (; iter < end && this->_text(this->m_Keys[iter]).size() == depth;
+             ++iter) {
+            if (rows[row + query.size()] <= maxDistance)
+                result.push_back(
+                    {rows[row + query.size()], this->m_Keys[iter].id});
+        }
+
+        while (iter < end) {
+            // the keys continuing with the same character are one child
+            const auto text = this->_text(this->m_Keys[iter]);
+            size_t next = depth;
+            const auto c = foldCase(nextUtf8CodePoint(text, next));
+            const auto bytes = text.substr(depth, next - depth);
+            const auto childEnd = size_t(
+                std::partition_point(
+                    this->m_Keys.begin() + ptrdiff_t(iter),
+                    this->m_Keys.begin() + ptrdiff_t(end),
+                    [&](const Key& key) {
+                        const auto other = this->_text(key);
+                        return compareFolded(other.substr(depth, bytes.size()),
+                                             bytes) == 0;
+                    }) -
+                this->m_Keys.begin());
+
+            rows.resize(rows.size() + width);
+            uint32_t best = rows[row + width] = rows[row] + 1;
+            for (size_t i = 1; i < width; ++i) {
+                const auto cost = query[i - 1] == c ? 0u : 1u;
+                const auto distance = std::min(
+                    {rows[row + i] + 1, rows[row + width + i - 1] + 1,
+                     rows[row + i - 1] + cost});
+                rows[row + width + i] = distance;
+                best = std::min(best, distance);
+            }
+            // distances only grow with every further character
+            if (best <= maxDistance)
+                this->_findSimilar(iter, childEnd, next, query, maxDistance,
+                                   rows, result);
+            rows.resize(rows.size() - width);
+            iter = childEnd;
+        }
+    }
+
+} // namespace detail
@@ -2,34 +2,30 @@
 
 #include <algorithm>
 #include <assert.h>
-#include <codecvt>
 #include <fstream>
 #include <iostream>
-#include <locale>
 #include <string_view>
-#include <sstream>
 #include <fstream>
 
 #include <sqlite3.h>
 #include <tinyxml2.h>
 
-inline static constexpr const wchar_t katakanaMin = L'ァ';
-inline static constexpr const wchar_t katakanaMax = L'ヶ';
+#include "detail/romaji.h"
+#include "detail/threadpool.h"
+#include "detail/util.hpp"
+#include "detail/vocabsearch.hpp"
 
-inline static constexpr const wchar_t hiraganaMin = L'ぁ';
-inline static constexpr const wchar_t hiraganaMax = L'ゖ';
+inline static constexpr const char32_t katakanaMin = U'ァ';
+inline static constexpr const char32_t katakanaMax = U'ヶ';
 
-namespace detail {
-
-    static std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t>
-        stringWstringConverter;
+inline static constexpr const char32_t hiraganaMin = U'ぁ';
+inline static constexpr const char32_t hiraganaMax = U'ゖ';
 
-    std::wstring convertUtf8Wstring(const std::string& str) {
-        return stringWstringConverter.from_bytes(str);
-    }
+namespace detail {
 
-    std::string convertWstringUtf8(const std::wstring& str) {
-        return stringWstringConverter.to_bytes(str);
+    static std::string_view elementText(const tinyxml2::XMLNode& node) {
+        const auto text = node.ToElement()->GetText();
+        return text ? text : "";
     }
 
     constexpr int simpleHash(std::string_view view) {
@@ -46,13 +42,30 @@ namespace detail {
             function(*child);
     }
 
-    std::wstring parse__r_ele(const tinyxml2::XMLNode& node) {
-        std::wstring kana;
+    // nf01 - nf48 are ranked by themselves (500 words each), the other
+    // tags only tell whether a word is in the first or second half of
+    // their list, so they follow after the ranked ones
+    uint8_t parsePriority(std::string_view priority) {
+        if (priority.size() == 4 && priority.substr(0, 2) == "nf") {
+            const auto rank = (priority[2] - '0') * 10 + (priority[3] - '0');
+            if (rank >= 1 && rank <= 48)
+                return uint8_t(rank);
+        }
+        if (!priority.empty() && priority.back() == '1')
+            return 49;
+        if (!priority.empty() && priority.back() == '2')
+            return 50;
+        return Vocabulary::NoFrequency;
+    }
+
+    std::string parse__r_ele(const tinyxml2::XMLNode& node,
+                             uint8_t& frequency) {
+        std::string kana;
         for_each_node(node, [&](const tinyxml2::XMLNode& node) {
             switch (simpleHash(node.ToElement()->Name())) {
             case simpleHash("reb"):
                 assert(kana.empty());
-                kana = convertUtf8Wstring(node.ToElement()->GetText());
+                kana = elementText(node);
                 break;
             case simpleHash("re_nokanji"):
                 // always empty?
@@ -62,6 +75,8 @@ namespace detail {
                 break;
             case simpleHash("re_pri"):
                 // indicator for how common the vocabluary is
+                frequency =
+                    std::min(frequency, parsePriority(elementText(node)));
                 break;
             case simpleHash("re_inf"):
                 // Typically it will be used to indicate some unusual aspect of
@@ -75,18 +90,41 @@ namespace detail {
         return kana;
     }
 
-    std::vector<std::wstring> parse__sense(const tinyxml2::XMLNode& node) {
-        std::vector<std::wstring> english;
+    std::string parse__k_ele(const tinyxml2::XMLNode& node,
+                             uint8_t& frequency) {
+        std::string kanji;
+        for_each_node(node, [&](const tinyxml2::XMLNode& node) {
+            switch (simpleHash(node.ToElement()->Name())) {
+            case simpleHash("keb"):
+                assert(kanji.empty());
+                kanji = elementText(node);
+                break;
+            case simpleHash("ke_pri"):
+                // same as re_pri
+                frequency =
+                    std::min(frequency, parsePriority(elementText(node)));
+                break;
+            case simpleHash("ke_inf"):
+                // unusual spelling, not used
+                break;
+            default:
+                assert(false);
+            }
+        });
+        assert(!kanji.empty());
+        return kanji;
+    }
+
+    std::vector<std::string> parse__sense(const tinyxml2::XMLNode& node) {
+        std::vector<std::string> english;
         for_each_node(node, [&](const tinyxml2::XMLNode& node) {
             switch (simpleHash(node.ToElement()->Name())) {
             case simpleHash("pos"):
                 // porbably no needed?
                 break;
-            case simpleHash("gloss"): {
-                std::wstring&& eng =
-                    convertUtf8Wstring(node.ToElement()->GetText());
-                english.push_back(std::move(eng));
-            } break;
+            case simpleHash("gloss"):
+                english.emplace_back(elementText(node));
+                break;
             case simpleHash("xref"):
                 // cross reference, not used
                 break;
@@ -132,17 +170,29 @@ namespace detail {
             case simpleHash("ent_seq"):
                 // only id?
                 break;
-            case simpleHash("r_ele"):
-                voc.kana = parse__r_ele(child);
-                break;
+            case simpleHash("r_ele"): {
+                // the first reading and spelling are the common ones, only
+                // their priorities count, the other forms are dropped
+                auto frequency = Vocabulary::NoFrequency;
+                auto kana = parse__r_ele(child, frequency);
+                if (voc.kana.empty()) {
+                    voc.kana = std::move(kana);
+                    voc.frequency = std::min(voc.frequency, frequency);
+                }
+            } break;
             case simpleHash("sense"): {
                 const auto english = parse__sense(child);
                 voc.english.insert(voc.english.end(), english.cbegin(),
                                    english.cend());
             } break;
-            case simpleHash("k_ele"):
-                // containing kaji, not used
-                break;
+            case simpleHash("k_ele"): {
+                auto frequency = Vocabulary::NoFrequency;
+                auto kanji = parse__k_ele(child, frequency);
+                if (voc.kanji.empty()) {
+                    voc.kanji = std::move(kanji);
+                    voc.frequency = std::min(voc.frequency, frequency);
+                }
+            } break;
             default:
                 assert(false);
             }
@@ -152,94 +202,253 @@ namespace detail {
         return voc;
     }
 
+    // pull reader handing out the raw xml of one <entry> after another,
+    // comments and the document type definition are skipped
+    struct JMDictEntryReader {
+        static constexpr const std::string_view EntryBegin = "<entry>";
+        static constexpr const std::string_view EntryEnd = "</entry>";
+        static constexpr const std::string_view CommentBegin = "<!--";
+        static constexpr const std::string_view CommentEnd = "-->";
+
+        JMDictEntryReader(std::string_view data) : m_Data(data) {}
+
+        std::optional<std::string_view> next() {
+            constexpr auto npos = std::string_view::npos;
+            for (auto pos = this->m_Data.find('<', this->m_Pos); pos != npos;
+                 pos = this->m_Data.find('<', pos + 1)) {
+                const auto rest = this->m_Data.substr(pos);
+                if (rest.substr(0, CommentBegin.size()) == CommentBegin) {
+                    pos = this->m_Data.find(CommentEnd,
+                                            pos + CommentBegin.size());
+                    if (pos == npos)
+                        break;
+                    continue;
+                }
+                if (rest.substr(0, EntryBegin.size()) != EntryBegin)
+                    continue;
+
+                const auto end =
+                    this->m_Data.find(EntryEnd, pos + EntryBegin.size());
+                if (end == npos) {
+                    this->m_Failed = true;
+                    break;
+                }
+                this->m_Pos = end + EntryEnd.size();
+                return this->m_Data.substr(pos, this->m_Pos - pos);
+            }
+            this->m_Pos = this->m_Data.size();
+            return std::nullopt;
+        }
+
+        // unterminated entry found
+        bool failed() const { return this->m_Failed; }
+
+      private:
+        const std::string_view m_Data;
+        size_t m_Pos = 0;
+        bool m_Failed = false;
+    };
+
     std::optional<VocabularyVector>
         VocParser::parseJMDictFile(const boost::filesystem::path& filePath) {
-        std::fstream file(filePath.string(), std::fstream::in);
-        std::string data((std::istreambuf_iterator<char>(file)),
-                         (std::istreambuf_iterator<char>()));
-        return parseJMDictData(data);
+        auto voc = std::make_optional<VocabularyVector>();
+        if (!parseJMDictFile(filePath, [&voc](Vocabulary&& e) {
+                voc->push_back(std::move(e));
+            })) {
+            return std::nullopt;
+        }
+        return voc;
     }
 
     std::optional<VocabularyVector>
         VocParser::parseJMDictData(std::string_view data) {
+        auto voc = std::make_optional<VocabularyVector>();
+        if (!parseJMDictData(data, [&voc](Vocabulary&& e) {
+                voc->push_back(std::move(e));
+            })) {
+            return std::nullopt;
+        }
+        return voc;
+    }
+
+    bool VocParser::parseJMDictFile(
+        const boost::filesystem::path& filePath,
+        const std::function<void(Vocabulary&&)>& onVocabulary) {
+        const util::MemoryMappedFile file(filePath.string());
+        if (!file)
+            return false;
+
+        file.adviseSequential();
+        return parseJMDictData(file.view(), onVocabulary);
+    }
+
+    bool VocParser::parseJMDictData(
+        std::string_view data,
+        const std::function<void(Vocabulary&&)>& onVocabulary) {
         using namespace tinyxml2;
 
+        // the document is reused, so its memory pools are only
+        // allocated once instead of once per entry
         XMLDocument document;
-        if (document.Parse(&data[0], data.size()) != XMLError::XML_SUCCESS ||
-            !document.RootElement())
-            return {};
+        JMDictEntryReader reader(data);
+        while (const auto entry = reader.next()) {
+            if (document.Parse(entry->data(), entry->size()) !=
+                    XMLError::XML_SUCCESS ||
+                !document.RootElement()) {
+                return false;
+            }
+            onVocabulary(parseEntry(*document.RootElement()));
+        }
+        return !reader.failed();
+    }
+
+    std::optional<VocabularyVector>
+        VocParser::parseJMDictFileParallel(
+            const boost::filesystem::path& filePath, size_t threadCount) {
+        const util::MemoryMappedFile file(filePath.string());
+        if (!file)
+            return std::nullopt;
+
+        return parseJMDictDataParallel(file.view(), threadCount);
+    }
+
+    std::optional<VocabularyVector>
+        VocParser::parseJMDictDataParallel(std::string_view data,
+                                           size_t threadCount) {
+        constexpr auto npos = std::string_view::npos;
+        constexpr auto EntryBegin = JMDictEntryReader::EntryBegin;
+
+        // the header may contain comments or a dtd mentioning '<entry>',
+        // only split behind the first real entry
+        JMDictEntryReader reader(data);
+        const auto firstEntry = reader.next();
+        if (!firstEntry) {
+            if (reader.failed())
+                return std::nullopt;
+            return std::make_optional<VocabularyVector>();
+        }
+
+        util::ThreadPool pool(
+            threadCount ? threadCount : util::ThreadPool::DefaultThreadCount());
+
+        // a few chunks per thread to even out differently sized entries
+        const size_t begin = size_t(firstEntry->data() - data.data());
+        const size_t chunkCount = pool.size() * 4;
+        const size_t chunkSize = (data.size() - begin) / chunkCount + 1;
+
+        using ChunkResult = std::optional<VocabularyVector>;
+        std::vector<std::future<ChunkResult>> chunks;
+        for (size_t chunkBegin = begin; chunkBegin < data.size();) {
+            auto chunkEnd = data.find(EntryBegin, chunkBegin + chunkSize);
+            if (chunkEnd == npos)
+                chunkEnd = data.size();
+
+            const auto chunk = data.substr(chunkBegin, chunkEnd - chunkBegin);
+            chunks.push_back(pool.submit([chunk]() {
+                auto voc = std::make_optional<VocabularyVector>();
+                if (!parseJMDictData(chunk, [&voc](Vocabulary&& e) {
+                        voc->push_back(std::move(e));
+                    })) {
+                    return ChunkResult();
+                }
+                return voc;
+            }));
+            chunkBegin = chunkEnd;
+        }
+
+        std::vector<ChunkResult> results;
+        size_t totalSize = 0;
+        for (auto& e : chunks) {
+            auto& chunk = results.emplace_back(e.get());
+            if (!chunk)
+                return std::nullopt;
+            totalSize += chunk->size();
+        }
 
         auto voc = std::make_optional<VocabularyVector>();
-        for_each_node(*document.RootElement(), [&](const XMLNode& node) {
-            voc->push_back(parseEntry(node));
-        });
+        voc->reserve(totalSize);
+        for (auto& e : results) {
+            voc->insert(voc->end(), std::make_move_iterator(e->begin()),
+                        std::make_move_iterator(e->end()));
+            *e = VocabularyVector();
+        }
         return voc;
     }
 
-    struct AnkiParseResult {
-        std::string utf8question;
-        std::string utf8answer;
-        bool operator<(const AnkiParseResult& rhs) const {
-            return this->utf8question < rhs.utf8question;
+    // text between the first '>' and the last '<', cards look like
+    // '<span ...>text</span>'
+    static std::string_view _stripAnkiHtml(std::string_view str) {
+        const auto p0 = str.find('>');
+        const auto p1 = str.rfind('<');
+        if (p0 == std::string_view::npos || p1 == std::string_view::npos ||
+            p1 <= p0) {
+            return str;
         }
-    };
-    [[nodiscard]] static std::vector<AnkiParseResult>
-        _parseAnkiDataBase(std::string_view filename) {
+        return str.substr(p0 + 1, p1 - p0 - 1);
+    }
 
-        sqlite3* db = nullptr;
-        if (const int res = sqlite3_open(filename.data(), &db);
-            res != SQLITE_OK) {
-            throw std::runtime_error("Unable to open database, error: " +
-                                     std::to_string(res));
-        }
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(db, "", -1, &stmt, nullptr) != SQLITE_OK)
+    static std::string_view _columnText(sqlite3_stmt* stmt, int column) {
+        const auto text =
+            reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        if (!text)
+            return {};
+
+        return {text, size_t(sqlite3_column_bytes(stmt, column))};
+    }
+
+    [[nodiscard]] static std::vector<AnkiParseResult>
+        _parseAnkiDataBase(const std::string& filename) {
+        // the databases are never written, immutable
+        // avoids any locking and change detection
+        util::Sqlite3OpenCloseHelper db(
+            util::sqlite3FileUri(filename, "immutable=1"),
+            SQLITE_OPEN_READONLY | SQLITE_OPEN_URI);
+        if (!db)
+            throw std::runtime_error("Unable to open database: " + filename);
+
+        (void)sqlite3_exec(db, "PRAGMA mmap_size = 268435456", nullptr,
+                           nullptr, nullptr);
+
+        util::Sqlite3StatementHelper countStmt(db,
+                                               "SELECT count(*) FROM cards");
+        util::Sqlite3StatementHelper stmt(db,
+                                          "SELECT question, answer FROM cards");
+        if (!countStmt || !stmt)
             throw std::runtime_error("Unable to prepare statement");
 
-        constexpr const char* sqlCommand = "SELECT question, answer FROM cards";
-        using ResultType = decltype(_parseAnkiDataBase(""));
-
-        auto callBack = [](void* result, int argc, char** argv,
-                           char** /* azColName */) {
-            assert(argc == 2);
-            auto& res = *static_cast<ResultType*>(result);
-            auto& element = res.emplace_back();
-            element.utf8question = argv[0];
-            element.utf8answer = argv[1];
-            return 0;
-        };
-        char* errMsg = nullptr;
-        ResultType result;
-        if (sqlite3_exec(db, sqlCommand, callBack, &result, &errMsg) !=
-            SQLITE_OK)
-            throw std::runtime_error("Unable to call exec on database");
-
-        sqlite3_finalize(stmt);
-        sqlite3_close(db);
-        auto extractVoc = [](std::string& str) {
-            const auto p0 = str.find('>');
-            const auto p1 = str.rfind('<');
-            assert(p0 != std::string::npos);
-            assert(p1 != std::string::npos);
-            assert(p1 > p0);
-            str = str.substr(p0 + 1, p1 - p0 - 1);
-        };
-        for (auto& e : result) {
-            if (e.utf8question.empty() || e.utf8answer.empty())
+        std::vector<AnkiParseResult> result;
+        if (sqlite3_step(countStmt) == SQLITE_ROW)
+            result.reserve(size_t(sqlite3_column_int64(countStmt, 0)));
+
+        int res = SQLITE_OK;
+        while ((res = sqlite3_step(stmt)) == SQLITE_ROW) {
+            // cards without question or answer never result in vocabulary
+            const auto question = _columnText(stmt, 0);
+            const auto answer = _columnText(stmt, 1);
+            if (question.empty() || answer.empty())
                 continue;
 
-            extractVoc(e.utf8answer);
-            extractVoc(e.utf8question);
+            // column text is only valid until the next step,
+            // copy the stripped text only once
+            auto& element = result.emplace_back();
+            element.utf8question = _stripAnkiHtml(question);
+            element.utf8answer = _stripAnkiHtml(answer);
         }
+        if (res != SQLITE_DONE)
+            throw std::runtime_error("Unable to read database: " + filename);
+
         return result;
     }
 
-    [[nodiscard]] std::vector<std::wstring> splitAnki(const std::wstring& str) {
-        std::vector<std::wstring> split;
-        std::wstringstream wsstr(str);
-        for (std::wstring value; std::getline(wsstr, value, L',');)
-            split.push_back(value);
-
+    [[nodiscard]] std::vector<std::string> splitAnki(std::string_view utf8) {
+        std::vector<std::string> split;
+        while (!utf8.empty()) {
+            const auto pos = utf8.find(',');
+            split.emplace_back(utf8.substr(0, pos));
+            if (pos == std::string_view::npos)
+                break;
+            utf8.remove_prefix(pos + 1);
+        }
         return split;
     }
 
@@ -257,10 +466,9 @@ namespace detail {
                                                             : ++iterHira) {
             if (iterEng->utf8question == iterHira->utf8question) {
                 auto& element = vm->emplace_back();
-                element.kanji = convertUtf8Wstring(iterEng->utf8question);
-                element.kana = convertUtf8Wstring(iterHira->utf8answer);
-                element.english =
-                    splitAnki(convertUtf8Wstring(iterEng->utf8answer));
+                element.kanji = iterEng->utf8question;
+                element.kana = iterHira->utf8answer;
+                element.english = splitAnki(iterEng->utf8answer);
             }
         }
         return vm;
@@ -270,19 +478,19 @@ namespace detail {
         VocabularyVector& vm,
         const decltype(_parseAnkiDataBase(""))& kanjiEng) {
 
-        auto isHiragana = [](std::wstring_view text) {
-            for (const auto& e : text) {
+        auto isHiragana = [](std::string_view text) {
+            for (size_t pos = 0; pos < text.size();) {
+                const auto e = nextUtf8CodePoint(text, pos);
                 if (e < hiraganaMin || e > hiraganaMax)
                     return false;
             }
             return true;
         };
         for (const auto& e : kanjiEng) {
-            std::wstring quest = convertUtf8Wstring(e.utf8question);
-            if (isHiragana(quest)) {
+            if (isHiragana(e.utf8question)) {
                 auto& element = vm.emplace_back();
-                element.kana = std::move(quest);
-                element.english = splitAnki(convertUtf8Wstring(e.utf8answer));
+                element.kana = e.utf8question;
+                element.english = splitAnki(e.utf8answer);
             }
         }
     }
@@ -290,105 +498,51 @@ namespace detail {
     std::optional<VocabularyVector> VocParser::parseAnkiDataBase(
         const boost::filesystem::path& fileNameKanjiEng,
         const boost::filesystem::path& fileNameKanjiHiragana) {
+        const auto eng = readAnkiDataBaseSorted(fileNameKanjiEng);
+        const auto hira = readAnkiDataBaseSorted(fileNameKanjiHiragana);
+        return mergeAnkiDataBases(eng, hira);
+    }
+
+    std::vector<AnkiParseResult> VocParser::readAnkiDataBaseSorted(
+        const boost::filesystem::path& fileName) {
         (void)sqlite3_initialize();
-        auto eng = _parseAnkiDataBase(fileNameKanjiEng.string());
-        auto hira = _parseAnkiDataBase(fileNameKanjiHiragana.string());
-        std::sort(eng.begin(), eng.end());
-        std::sort(hira.begin(), hira.end());
+        auto result = _parseAnkiDataBase(fileName.string());
+        std::sort(result.begin(), result.end());
+        return result;
+    }
 
-        auto vm = _merge_KanjiEng_KanjiHiragana(eng, hira);
+    std::optional<VocabularyVector> VocParser::mergeAnkiDataBases(
+        const std::vector<AnkiParseResult>& sortedKanjiEng,
+        const std::vector<AnkiParseResult>& sortedKanjiHiragana) {
+        auto vm =
+            _merge_KanjiEng_KanjiHiragana(sortedKanjiEng, sortedKanjiHiragana);
         assert(vm);
 
         // kanji may only be hiragana symbos...
         // we have to add those...
-        _appendAnki_KanjiActualHiragana(*vm, eng);
+        _appendAnki_KanjiActualHiragana(*vm, sortedKanjiEng);
 
         return vm;
     }
 
-    std::wostream& operator<<(std::wostream& os, const Vocabulary& voc) {
-        os << L"Kana: " << voc.kana << L"\nEnglish:\n";
+    std::ostream& operator<<(std::ostream& os, const Vocabulary& voc) {
+        os << "Kana: " << voc.kana << "\nEnglish:\n";
         for (const auto& e : voc.english)
-            os << e << L"; ";
-        os << L'\n';
+            os << e << "; ";
+        os << '\n';
         return os;
     }
 
-    namespace impl {
-
-        template <typename _IteratorType, typename _VocManager,
-                  typename _SearchFunction, typename _PartitonFunction>
-        std::vector<_IteratorType> _findAll(_VocManager& voc,
-                                            _SearchFunction&& searchFunc,
-                                            _PartitonFunction&& partitionFunc) {
-            std::vector<_IteratorType> result;
-            for (auto iter = std::find_if(voc.begin(), voc.end(), searchFunc);
-                 iter != voc.end();
-                 ++iter, iter = std::find_if(iter, voc.end(), searchFunc))
-                result.push_back(iter);
-
-            auto iter =
-                std::partition(result.begin(), result.end(),
-                               std::forward<_PartitonFunction>(partitionFunc));
-
-            std::sort(result.begin(), iter,
-                      [](_IteratorType lhs, _IteratorType rhs) {
-                          return int(lhs->type) < int(rhs->type);
-                      });
-
-            return result;
-        }
-
-        template <typename _IteratorType, typename _VocManager>
-        std::vector<_IteratorType> _findAllEnglish(_VocManager& voc,
-                                                   std::wstring_view english) {
-            auto searchFunc = [&](const Vocabulary& voc) {
-                return std::find_if(voc.english.begin(), voc.english.end(),
-                                    [&](const std::wstring& str) {
-                                        const auto start = str.find(english);
-                                        if (start == std::wstring::npos)
-                                            return false;
-
-                                        if (start > 0 && str[start - 1] != L' ')
-                                            return false;
-
-                                        const auto end = start + english.size();
-                                        if (end < str.size() &&
-                                            str[end] != L' ')
-                                            return false;
-
-                                        return true;
-                                    }) != voc.english.end();
-            };
-            auto partitionFunc = [&](const _IteratorType i) {
-                return std::find(i->english.cbegin(), i->english.cend(),
-                                 english) != i->english.cend();
-            };
-            return _findAll<_IteratorType>(voc, searchFunc, partitionFunc);
-        }
-
-        template <typename _IteratorType, typename _VocManager>
-        std::vector<_IteratorType> _findAllKana(_VocManager& voc,
-                                                std::wstring_view kana) {
-            auto searchFunction = [&](const Vocabulary& str) {
-                return str.kana.find(kana) != std::wstring::npos;
-            };
-            auto partitionFunc = [&](const _IteratorType i) {
-                return i->kana == kana;
-            };
-            return _findAll<_IteratorType>(voc, searchFunction, partitionFunc);
-        }
-
-    } // namespace impl
-
     std::vector<std::vector<Vocabulary>::const_iterator>
-        VocabularyVector::findAllEnglish(std::wstring_view english) const {
-        return impl::_findAllEnglish<const_iterator>(*this, english);
+        VocabularyVector::findAllEnglish(std::string_view english,
+                                         size_t limit) const {
+        return impl::_findAllEnglish<const_iterator>(*this, english, limit);
     }
 
     std::vector<std::vector<Vocabulary>::const_iterator>
-        VocabularyVector::findAllKana(std::wstring_view kana) const {
-        return impl::_findAllKana<const_iterator>(*this, kana);
+        VocabularyVector::findAllKana(std::string_view kana,
+                                      size_t limit) const {
+        return impl::_findAllKana<const_iterator>(*this, kana, limit);
     }
 
     std::vector<std::vector<Vocabulary>::const_iterator>
@@ -409,41 +563,42 @@ namespace detail {
         return impl::_findAll<const_iterator>(*this, predicate, partitionFunc);
     }
 
-    std::wstring Vocabulary::ConvertKanaToHiraganaOnly(std::wstring_view kana) {
-        std::wstring res(kana);
-        std::transform(res.cbegin(), res.cend(), res.begin(), [](wchar_t c) {
+    std::string Vocabulary::ConvertKanaToHiraganaOnly(std::string_view kana) {
+        std::string res;
+        res.reserve(kana.size());
+        char32_t prev = 0;
+        for (size_t pos = 0; pos < kana.size();) {
+            char32_t c = nextUtf8CodePoint(kana, pos);
             if (c >= katakanaMin && c <= katakanaMax)
                 c = c - katakanaMin + hiraganaMin;
-            return c;
-        });
-        auto secondBegin = res.begin();
-        ++secondBegin;
-        std::transform(secondBegin, res.end(), res.begin(), secondBegin,
-                       [](wchar_t second, wchar_t first) {
-                           return second == L'ー' ? first : second;
-                       });
+            // long vowel mark repeats the previous symbol
+            if (c == U'ー' && prev != 0)
+                c = prev;
+            appendUtf8CodePoint(c, res);
+            prev = c;
+        }
         return res;
     }
 
-    std::wstring Vocabulary::ConvertKanaToKatakanaOnly(std::wstring_view kana) {
-        std::wstring res(kana);
-        std::transform(res.cbegin(), res.cend(), res.begin(), [](wchar_t c) {
+    std::string Vocabulary::ConvertKanaToKatakanaOnly(std::string_view kana) {
+        std::string res;
+        res.reserve(kana.size());
+        char32_t prev = 0;
+        for (size_t pos = 0; pos < kana.size();) {
+            char32_t c = nextUtf8CodePoint(kana, pos);
             if (c >= hiraganaMin && c <= hiraganaMax)
                 c = c - hiraganaMin + katakanaMin;
-            return c;
-        });
-        auto secondBegin = res.begin();
-        ++secondBegin;
-        std::transform(secondBegin, res.end(), res.begin(), secondBegin,
-                       [](wchar_t second, wchar_t first) {
-                           return first == second ? L'ー' : second;
-                       });
+            if (c == prev)
+                c = U'ー';
+            appendUtf8CodePoint(c, res);
+            prev = c;
+        }
         return res;
     }
 
-    Vocabulary::Vocabulary(std::wstring_view _kana,
-                           const std::vector<std::wstring>& _english,
-                           Vocabulary::Type _type, std::wstring_view _kanji)
+    Vocabulary::Vocabulary(std::string_view _kana,
+                           const std::vector<std::string>& _english,
+                           Vocabulary::Type _type, std::string_view _kanji)
         : type(_type), kana(_kana), kanji(_kanji), english(_english) {}
 
     bool Vocabulary::operator==(const Vocabulary& rhs) const {
@@ -455,321 +610,84 @@ namespace detail {
         return !(*this == rhs);
     }
 
-    std::wstring Vocabulary::ConvertKanaToRomanji(std::wstring_view kana) {
-        std::wstring res;
-        const auto hiragana = Vocabulary::ConvertKanaToHiraganaOnly(kana);
-        res.reserve(hiragana.size() *
-                    2); // on average about 2 symbols per hiaragana
-
-        std::for_each(hiragana.cbegin(), hiragana.cend(), [&res](wchar_t h) {
-            switch (h) {
-            case L'ぁ':
-            case L'あ':
-                res += L'a';
-                break;
-            case L'ぃ':
-            case L'い':
-                res += L'i';
-                break;
-            case L'ぅ':
-            case L'う':
-                res += L'u';
-                break;
-            case L'ぇ':
-            case L'え':
-                res += L'e';
-                break;
-            case L'ぉ':
-            case L'お':
-                res += L'o';
-                break;
-            case L'ゕ':
-            case L'か':
-                res += L"ka";
-                break;
-            case L'が':
-                res += L"ga";
-                break;
-            case L'き':
-                res += L"ki";
-                break;
-            case L'ぎ':
-                res += L"gi";
-                break;
-            case L'く':
-                res += L"ku";
-                break;
-            case L'ぐ':
-                res += L"gu";
-                break;
-            case L'ゖ':
-            case L'け':
-                res += L"ke";
-                break;
-            case L'げ':
-                res += L"ge";
-                break;
-            case L'こ':
-                res += L"ko";
-                break;
-            case L'ご':
-                res += L"go";
-                break;
-            case L'さ':
-                res += L"sa";
-                break;
-            case L'ざ':
-                res += L"za";
-                break;
-            case L'し':
-                res += L"shi";
-                break;
-            case L'じ':
-                res += L"ji";
-                break;
-            case L'す':
-                res += L"su";
-                break;
-            case L'ず':
-                res += L"zu";
-                break;
-            case L'せ':
-                res += L"se";
-                break;
-            case L'ぜ':
-                res += L"ze";
-                break;
-            case L'そ':
-                res += L"so";
-                break;
-            case L'ぞ':
-                res += L"zo";
-                break;
-            case L'た':
-                res += L"ta";
-                break;
-            case L'だ':
-                res += L"da";
-                break;
-            case L'ち':
-                res += L"chi";
-                break;
-            case L'ぢ':
-                res += L"ji";
-                break;
-            case L'っ':
-            case L'つ':
-                res += L"tsu";
-                break;
-            case L'づ':
-                res += L"zu";
-                break;
-            case L'て':
-                res += L"te";
-                break;
-            case L'で':
-                res += L"de";
-                break;
-            case L'と':
-                res += L"to";
-                break;
-            case L'ど':
-                res += L"do";
-                break;
-            case L'な':
-                res += L"na";
-                break;
-            case L'に':
-                res += L"ni";
-                break;
-            case L'ぬ':
-                res += L"nu";
-                break;
-            case L'ね':
-                res += L"ne";
-                break;
-            case L'の':
-                res += L"no";
-                break;
-            case L'は':
-                res += L"ha";
-                break;
-            case L'ば':
-                res += L"ba";
-                break;
-            case L'ぱ':
-                res += L"pa";
-                break;
-            case L'ひ':
-                res += L"hi";
-                break;
-            case L'び':
-                res += L"bi";
-                break;
-            case L'ぴ':
-                res += L"pi";
-                break;
-            case L'ふ':
-                res += L"fu";
-                break;
-            case L'ぶ':
-                res += L"bu";
-                break;
-            case L'ぷ':
-                res += L"pu";
-                break;
-            case L'へ':
-                res += L"he";
-                break;
-            case L'べ':
-                res += L"be";
-                break;
-            case L'ぺ':
-                res += L"pe";
-                break;
-            case L'ほ':
-                res += L"ho";
-                break;
-            case L'ぼ':
-                res += L"bo";
-                break;
-            case L'ぽ':
-                res += L"po";
-                break;
-            case L'ま':
-                res += L"ma";
-                break;
-            case L'み':
-                res += L"mi";
-                break;
-            case L'む':
-                res += L"mu";
-                break;
-            case L'め':
-                res += L"me";
-                break;
-            case L'も':
-                res += L"mo";
-                break;
-            case L'ゃ':
-            case L'や':
-                res += L"ya";
-                break;
-            case L'ゅ':
-            case L'ゆ':
-                res += L"yu";
-                break;
-            case L'ょ':
-            case L'よ':
-                res += L"yo";
-                break;
-            case L'ら':
-                res += L"ra";
-                break;
-            case L'り':
-                res += L"ri";
-                break;
-            case L'る':
-                res += L"ru";
-                break;
-            case L'れ':
-                res += L"re";
-                break;
-            case L'ろ':
-                res += L"ro";
-                break;
-            case L'ゎ':
-            case L'わ':
-                res += L"wa";
-                break;
-            case L'を':
-                res += L"wo";
-                break;
-            case L'ん':
-                res += L'n';
-                break;
-            default:
-                break;
-            }
-        });
-        // maybe add support for 'ju -> jiyu' and so on
-        return res;
+    std::string Vocabulary::ConvertKanaToRomanji(std::string_view kana) {
+        return convertKanaToRomaji(kana);
     }
 
     const std::vector<Vocabulary> Vocabulary::HiraganaSingleCharacters = {
-        {L"あ", {L"a"}},   {L"い", {L"i"}},  {L"う", {L"u"}},
-        {L"え", {L"e"}},   {L"お", {L"o"}},  {L"か", {L"ka"}},
-        {L"が", {L"ga"}},  {L"き", {L"ki"}}, {L"ぎ", {L"gi"}},
-        {L"く", {L"ku"}},  {L"ぐ", {L"gu"}}, {L"け", {L"ke"}},
-        {L"げ", {L"ge"}},  {L"こ", {L"ko"}}, {L"ご", {L"go"}},
-        {L"さ", {L"sa"}},  {L"ざ", {L"za"}}, {L"し", {L"shi"}},
-        {L"じ", {L"ji"}},  {L"す", {L"su"}}, {L"ず", {L"zu"}},
-        {L"せ", {L"se"}},  {L"ぜ", {L"ze"}}, {L"そ", {L"so"}},
-        {L"ぞ", {L"zo"}},  {L"た", {L"ta"}}, {L"だ", {L"da"}},
-        {L"ち", {L"chi"}}, {L"ぢ", {L"ji"}}, {L"つ", {L"tsu"}},
-        {L"づ", {L"zu"}},  {L"て", {L"te"}}, {L"で", {L"de"}},
-        {L"と", {L"to"}},  {L"ど", {L"do"}}, {L"な", {L"na"}},
-        {L"に", {L"ni"}},  {L"ぬ", {L"nu"}}, {L"ね", {L"ne"}},
-        {L"の", {L"no"}},  {L"は", {L"ha"}}, {L"ば", {L"ba"}},
-        {L"ぱ", {L"pa"}},  {L"ひ", {L"hi"}}, {L"び", {L"bi"}},
-        {L"ぴ", {L"pi"}},  {L"ふ", {L"fu"}}, {L"ぶ", {L"bu"}},
-        {L"ぷ", {L"pu"}},  {L"へ", {L"he"}}, {L"べ", {L"be"}},
-        {L"ぺ", {L"pe"}},  {L"ほ", {L"ho"}}, {L"ぼ", {L"bo"}},
-        {L"ぽ", {L"po"}},  {L"ま", {L"ma"}}, {L"み", {L"mi"}},
-        {L"む", {L"mu"}},  {L"め", {L"me"}}, {L"も", {L"mo"}},
-        {L"や", {L"ya"}},  {L"ゆ", {L"yu"}}, {L"よ", {L"yo"}},
-        {L"ら", {L"ra"}},  {L"り", {L"ri"}}, {L"る", {L"ru"}},
-        {L"れ", {L"re"}},  {L"ろ", {L"ro"}}, {L"わ", {L"wa"}},
-        {L"を", {L"wo"}},  {L"ん", {L"n"}},
+        {u8"あ", {"a"}},   {u8"い", {"i"}},  {u8"う", {"u"}},
+        {u8"え", {"e"}},   {u8"お", {"o"}},  {u8"か", {"ka"}},
+        {u8"が", {"ga"}},  {u8"き", {"ki"}}, {u8"ぎ", {"gi"}},
+        {u8"く", {"ku"}},  {u8"ぐ", {"gu"}}, {u8"け", {"ke"}},
+        {u8"げ", {"ge"}},  {u8"こ", {"ko"}}, {u8"ご", {"go"}},
+        {u8"さ", {"sa"}},  {u8"ざ", {"za"}}, {u8"し", {"shi"}},
+        {u8"じ", {"ji"}},  {u8"す", {"su"}}, {u8"ず", {"zu"}},
+        {u8"せ", {"se"}},  {u8"ぜ", {"ze"}}, {u8"そ", {"so"}},
+        {u8"ぞ", {"zo"}},  {u8"た", {"ta"}}, {u8"だ", {"da"}},
+        {u8"ち", {"chi"}}, {u8"ぢ", {"ji"}}, {u8"つ", {"tsu"}},
+        {u8"づ", {"zu"}},  {u8"て", {"te"}}, {u8"で", {"de"}},
+        {u8"と", {"to"}},  {u8"ど", {"do"}}, {u8"な", {"na"}},
+        {u8"に", {"ni"}},  {u8"ぬ", {"nu"}}, {u8"ね", {"ne"}},
+        {u8"の", {"no"}},  {u8"は", {"ha"}}, {u8"ば", {"ba"}},
+        {u8"ぱ", {"pa"}},  {u8"ひ", {"hi"}}, {u8"び", {"bi"}},
+        {u8"ぴ", {"pi"}},  {u8"ふ", {"fu"}}, {u8"ぶ", {"bu"}},
+        {u8"ぷ", {"pu"}},  {u8"へ", {"he"}}, {u8"べ", {"be"}},
+        {u8"ぺ", {"pe"}},  {u8"ほ", {"ho"}}, {u8"ぼ", {"bo"}},
+        {u8"ぽ", {"po"}},  {u8"ま", {"ma"}}, {u8"み", {"mi"}},
+        {u8"む", {"mu"}},  {u8"め", {"me"}}, {u8"も", {"mo"}},
+        {u8"や", {"ya"}},  {u8"ゆ", {"yu"}}, {u8"よ", {"yo"}},
+        {u8"ら", {"ra"}},  {u8"り", {"ri"}}, {u8"る", {"ru"}},
+        {u8"れ", {"re"}},  {u8"ろ", {"ro"}}, {u8"わ", {"wa"}},
+        {u8"を", {"wo"}},  {u8"ん", {"n"}},
     };
     const std::vector<Vocabulary> Vocabulary::HiraganaMultiCharacters = {
-        {L"りゃ", {L"rya"}}, {L"りゅ", {L"ryu"}}, {L"りょ", {L"ryo"}},
-        {L"みゃ", {L"mya"}}, {L"みゅ", {L"myu"}}, {L"みょ", {L"myo"}},
-        {L"ぴゃ", {L"pya"}}, {L"ぴゅ", {L"pyu"}}, {L"ぴょ", {L"pyo"}},
-        {L"びゃ", {L"bya"}}, {L"びゅ", {L"byu"}}, {L"びょ", {L"byo"}},
-        {L"ひゃ", {L"hya"}}, {L"ひゅ", {L"hyu"}}, {L"ひょ", {L"hyo"}},
-        {L"にゃ", {L"nya"}}, {L"にゅ", {L"nyu"}}, {L"にょ", {L"nyo"}},
-        {L"ちゃ", {L"cha"}}, {L"ちゅ", {L"chu"}}, {L"ちょ", {L"cho"}},
-        {L"じゃ", {L"ja"}},  {L"じゅ", {L"ju"}},  {L"じょ", {L"jo"}},
-        {L"しゃ", {L"sha"}}, {L"しゅ", {L"shu"}}, {L"しょ", {L"sho"}},
-        {L"ぎゃ", {L"gya"}}, {L"ぎゅ", {L"gyu"}}, {L"ぎょ", {L"gyo"}},
-        {L"きゃ", {L"kya"}}, {L"きゅ", {L"kyu"}}, {L"きょ", {L"kyo"}},
+        {u8"りゃ", {"rya"}}, {u8"りゅ", {"ryu"}}, {u8"りょ", {"ryo"}},
+        {u8"みゃ", {"mya"}}, {u8"みゅ", {"myu"}}, {u8"みょ", {"myo"}},
+        {u8"ぴゃ", {"pya"}}, {u8"ぴゅ", {"pyu"}}, {u8"ぴょ", {"pyo"}},
+        {u8"びゃ", {"bya"}}, {u8"びゅ", {"byu"}}, {u8"びょ", {"byo"}},
+        {u8"ひゃ", {"hya"}}, {u8"ひゅ", {"hyu"}}, {u8"ひょ", {"hyo"}},
+        {u8"にゃ", {"nya"}}, {u8"にゅ", {"nyu"}}, {u8"にょ", {"nyo"}},
+        {u8"ちゃ", {"cha"}}, {u8"ちゅ", {"chu"}}, {u8"ちょ", {"cho"}},
+        {u8"じゃ", {"ja"}},  {u8"じゅ", {"ju"}},  {u8"じょ", {"jo"}},
+        {u8"しゃ", {"sha"}}, {u8"しゅ", {"shu"}}, {u8"しょ", {"sho"}},
+        {u8"ぎゃ", {"gya"}}, {u8"ぎゅ", {"gyu"}}, {u8"ぎょ", {"gyo"}},
+        {u8"きゃ", {"kya"}}, {u8"きゅ", {"kyu"}}, {u8"きょ", {"kyo"}},
     };
 
     const std::vector<Vocabulary> Vocabulary::KatakanaMultiCharacters = {
-        {L"ア", {L"a"}},   {L"イ", {L"i"}},  {L"ウ", {L"u"}},
-        {L"エ", {L"e"}},   {L"オ", {L"o"}},  {L"カ", {L"ka"}},
-        {L"ガ", {L"ga"}},  {L"キ", {L"ki"}}, {L"ギ", {L"gi"}},
-        {L"ク", {L"ku"}},  {L"グ", {L"gu"}}, {L"ケ", {L"ke"}},
-        {L"ゲ", {L"ge"}},  {L"コ", {L"ko"}}, {L"ゴ", {L"go"}},
-        {L"サ", {L"sa"}},  {L"ザ", {L"za"}}, {L"シ", {L"shi"}},
-        {L"ジ", {L"ji"}},  {L"ス", {L"su"}}, {L"ズ", {L"zu"}},
-        {L"セ", {L"se"}},  {L"ゼ", {L"ze"}}, {L"ソ", {L"so"}},
-        {L"ゾ", {L"zo"}},  {L"タ", {L"ta"}}, {L"ダ", {L"da"}},
-        {L"チ", {L"chi"}}, {L"ヂ", {L"ji"}}, {L"ツ", {L"tsu"}},
-        {L"ヅ", {L"zu"}},  {L"テ", {L"te"}}, {L"デ", {L"de"}},
-        {L"ト", {L"to"}},  {L"ド", {L"do"}}, {L"ナ", {L"na"}},
-        {L"ニ", {L"ni"}},  {L"ヌ", {L"nu"}}, {L"ネ", {L"ne"}},
-        {L"ノ", {L"no"}},  {L"ハ", {L"ha"}}, {L"バ", {L"ba"}},
-        {L"パ", {L"pa"}},  {L"ヒ", {L"hi"}}, {L"ビ", {L"bi"}},
-        {L"ピ", {L"pi"}},  {L"フ", {L"fu"}}, {L"ブ", {L"bu"}},
-        {L"プ", {L"pu"}},  {L"ヘ", {L"he"}}, {L"ベ", {L"be"}},
-        {L"ペ", {L"pe"}},  {L"ホ", {L"ho"}}, {L"ボ", {L"bo"}},
-        {L"ポ", {L"po"}},  {L"マ", {L"ma"}}, {L"ミ", {L"mi"}},
-        {L"ム", {L"mu"}},  {L"メ", {L"me"}}, {L"モ", {L"mo"}},
-        {L"ヤ", {L"ya"}},  {L"ユ", {L"yu"}}, {L"ヨ", {L"yo"}},
-        {L"ラ", {L"ra"}},  {L"リ", {L"ri"}}, {L"ル", {L"ru"}},
-        {L"レ", {L"re"}},  {L"ロ", {L"ro"}}, {L"ワ", {L"wa"}},
-        {L"ヲ", {L"wo"}},  {L"ン", {L"n"}},  {L"ヴ", {L"b/v"}},
+        {u8"ア", {"a"}},   {u8"イ", {"i"}},  {u8"ウ", {"u"}},
+        {u8"エ", {"e"}},   {u8"オ", {"o"}},  {u8"カ", {"ka"}},
+        {u8"ガ", {"ga"}},  {u8"キ", {"ki"}}, {u8"ギ", {"gi"}},
+        {u8"ク", {"ku"}},  {u8"グ", {"gu"}}, {u8"ケ", {"ke"}},
+        {u8"ゲ", {"ge"}},  {u8"コ", {"ko"}}, {u8"ゴ", {"go"}},
+        {u8"サ", {"sa"}},  {u8"ザ", {"za"}}, {u8"シ", {"shi"}},
+        {u8"ジ", {"ji"}},  {u8"ス", {"su"}}, {u8"ズ", {"zu"}},
+        {u8"セ", {"se"}},  {u8"ゼ", {"ze"}}, {u8"ソ", {"so"}},
+        {u8"ゾ", {"zo"}},  {u8"タ", {"ta"}}, {u8"ダ", {"da"}},
+        {u8"チ", {"chi"}}, {u8"ヂ", {"ji"}}, {u8"ツ", {"tsu"}},
+        {u8"ヅ", {"zu"}},  {u8"テ", {"te"}}, {u8"デ", {"de"}},
+        {u8"ト", {"to"}},  {u8"ド", {"do"}}, {u8"ナ", {"na"}},
+        {u8"ニ", {"ni"}},  {u8"ヌ", {"nu"}}, {u8"ネ", {"ne"}},
+        {u8"ノ", {"no"}},  {u8"ハ", {"ha"}}, {u8"バ", {"ba"}},
+        {u8"パ", {"pa"}},  {u8"ヒ", {"hi"}}, {u8"ビ", {"bi"}},
+        {u8"ピ", {"pi"}},  {u8"フ", {"fu"}}, {u8"ブ", {"bu"}},
+        {u8"プ", {"pu"}},  {u8"ヘ", {"he"}}, {u8"ベ", {"be"}},
+        {u8"ペ", {"pe"}},  {u8"ホ", {"ho"}}, {u8"ボ", {"bo"}},
+        {u8"ポ", {"po"}},  {u8"マ", {"ma"}}, {u8"ミ", {"mi"}},
+        {u8"ム", {"mu"}},  {u8"メ", {"me"}}, {u8"モ", {"mo"}},
+        {u8"ヤ", {"ya"}},  {u8"ユ", {"yu"}}, {u8"ヨ", {"yo"}},
+        {u8"ラ", {"ra"}},  {u8"リ", {"ri"}}, {u8"ル", {"ru"}},
+        {u8"レ", {"re"}},  {u8"ロ", {"ro"}}, {u8"ワ", {"wa"}},
+        {u8"ヲ", {"wo"}},  {u8"ン", {"n"}},  {u8"ヴ", {"b/v"}},
     };
     const std::vector<Vocabulary> Vocabulary::KatakanaSingleCharacters = {
-        {L"イェ", {L"ie"}},    {L"ウェ", {L"we"}},    {L"ウィ", {L"wi"}},
-        {L"ウォ", {L"wo"}},    {L"ヴァ", {L"ba/va"}}, {L"ヴェ", {L"be/ve"}},
-        {L"ヴィ", {L"bi/vi"}}, {L"ヴォ", {L"bo/vo"}}, {L"シェ", {L"she"}},
-        {L"ジェ", {L"je"}},    {L"チェ", {L"che"}},   {L"ティ", {L"ti"}},
-        {L"ディ", {L"di"}},    {L"トゥ", {L"tu"}},    {L"ドゥ", {L"du"}},
-        {L"フェ", {L"fe"}},    {L"フィ", {L"fi"}},    {L"フォ", {L"fo"}},
-        {L"ファ", {L"fa"}},
+        {u8"イェ", {"ie"}},    {u8"ウェ", {"we"}},    {u8"ウィ", {"wi"}},
+        {u8"ウォ", {"wo"}},    {u8"ヴァ", {"ba/va"}}, {u8"ヴェ", {"be/ve"}},
+        {u8"ヴィ", {"bi/vi"}}, {u8"ヴォ", {"bo/vo"}}, {u8"シェ", {"she"}},
+        {u8"ジェ", {"je"}},    {u8"チェ", {"che"}},   {u8"ティ", {"ti"}},
+        {u8"ディ", {"di"}},    {u8"トゥ", {"tu"}},    {u8"ドゥ", {"du"}},
+        {u8"フェ", {"fe"}},    {u8"フィ", {"fi"}},    {u8"フォ", {"fo"}},
+        {u8"ファ", {"fa"}},
     };
 
 } // namespace detail
@@ -0,0 +1,208 @@
+#include "detail/vocabsegment.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include "detail/normalize.h"
+
+namespace detail {
+
+    Vocabulary VocabularyRef::toVocabulary() const {
+        Vocabulary voc;
+        voc.type = this->type;
+        voc.frequency = this->frequency;
+        voc.kana = this->kana;
+        voc.kanji = this->kanji;
+        voc.english.assign(this->english.begin(), this->english.end());
+        return voc;
+    }
+
+    bool VocabularyRef::operator==(const Vocabulary& rhs) const {
+        return this->type == rhs.type && this->kana == rhs.kana &&
+               this->kanji == rhs.kanji &&
+               std::equal(this->english.begin(), this->english.end(),
+                          rhs.english.begin(), rhs.english.end());
+    }
+
+    bool VocabularyRef::operator!=(const Vocabulary& rhs) const {
+        return !(*this == rhs);
+    }
+
+    namespace {
+        struct SegmentStorage {
+            std::vector<VocabularySegment::Record> records;
+            std::vector<VocabularySegment::StringRef> strings;
+            std::string chars;
+        };
+
+        struct KeyStorage {
+            // owner of the shared records
+            VocabularySegment segment;
+            std::vector<VocabularySegment::StringRef> strings;
+            std::string chars;
+        };
+    } // namespace
+
+    VocabularySegment::VocabularySegment(const VocabularyVector& vocs) {
+        auto storage = std::make_shared<SegmentStorage>();
+        size_t stringCount = 0;
+        size_t charCount = 0;
+        for (const auto& voc : vocs) {
+            stringCount += 2 + voc.english.size();
+            charCount += voc.kana.size() + voc.kanji.size();
+            for (const auto& e : voc.english)
+                charCount += e.size();
+        }
+        if (stringCount >= std::numeric_limits<uint32_t>::max() ||
+            charCount >= std::numeric_limits<uint32_t>::max()) {
+            throw std::length_error("Vocabulary segment too large");
+        }
+        storage->records.reserve(vocs.size());
+        storage->strings.reserve(stringCount);
+        storage->chars.reserve(charCount);
+
+        // ordered by type and frequency, so ids are in the order search
+        // results are ranked in, a no-op for already ordered vocabulary
+        std::vector<const Vocabulary*> grouped(vocs.size());
+        std::transform(vocs.begin(), vocs.end(), grouped.begin(),
+                       [](const Vocabulary& voc) { return &voc; });
+        std::stable_sort(grouped.begin(), grouped.end(),
+                         [](const Vocabulary* lhs, const Vocabulary* rhs) {
+                             if (lhs->type != rhs->type)
+                                 return lhs->type < rhs->type;
+                             return lhs->frequency < rhs->frequency;
+                         });
+
+        auto addString = [&](const std::string& str) {
+            storage->strings.push_back(
+                {uint32_t(storage->chars.size()), uint32_t(str.size())});
+            storage->chars += str;
+            return uint32_t(storage->strings.size() - 1);
+        };
+        for (const auto voc : grouped) {
+            auto& record = storage->records.emplace_back();
+            record.type = uint16_t(voc->type);
+            record.frequency = voc->frequency;
+            record.kana = addString(voc->kana);
+            record.kanji = addString(voc->kanji);
+            record.englishBegin = uint32_t(storage->strings.size());
+            record.englishCount = uint32_t(voc->english.size());
+            for (const auto& e : voc->english)
+                addString(e);
+        }
+
+        this->m_Records = storage->records.data();
+        this->m_RecordCount = storage->records.size();
+        this->m_Strings = storage->strings.data();
+        this->m_StringCount = storage->strings.size();
+        this->m_Chars = storage->chars.data();
+        this->m_CharCount = storage->chars.size();
+        this->m_Owner = std::move(storage);
+        this->_computeTypeRanges();
+    }
+
+    VocabularySegment::VocabularySegment(const Record* records,
+                                         size_t recordCount,
+                                         const StringRef* strings,
+                                         size_t stringCount,
+                                         const char* chars, size_t charCount,
+                                         std::shared_ptr<const void> owner)
+        : m_Records(records), m_RecordCount(recordCount), m_Strings(strings),
+          m_StringCount(stringCount), m_Chars(chars), m_CharCount(charCount),
+          m_Owner(std::move(owner)) {
+        this->_computeTypeRanges();
+    }
+
+    VocabularySegment VocabularySegment::englishKeys() const {
+        auto storage = std::make_shared<KeyStorage>();
+        storage->segment = *this;
+        storage->strings.assign(this->m_StringCount, StringRef{0, 0});
+
+        // a key is never longer than its translation
+        size_t charCount = 0;
+        for (size_t i = 0; i < this->m_RecordCount; ++i) {
+            const auto& record = this->m_Records[i];
+            for (uint32_t e = 0; e < record.englishCount; ++e)
+                charCount += this->m_Strings[record.englishBegin + e].length;
+        }
+        storage->chars.reserve(charCount);
+
+        for (size_t i = 0; i < this->m_RecordCount; ++i) {
+            const auto& record = this->m_Records[i];
+            for (uint32_t e = 0; e < record.englishCount; ++e) {
+                const auto idx = record.englishBegin + e;
+                const auto offset = storage->chars.size();
+                appendNormalizedEnglish(this->getString(idx), storage->chars);
+                storage->strings[idx] = {
+                    uint32_t(offset),
+                    uint32_t(storage->chars.size() - offset)};
+            }
+        }
+
+        const auto strings = storage->strings.data();
+        const auto chars = storage->chars.data();
+        const auto keyCharCount = storage->chars.size();
+        return VocabularySegment(this->m_Records, this->m_RecordCount, strings,
+                                 this->m_StringCount, chars, keyCharCount,
+                                 std::move(storage));
+    }
+
+    void VocabularySegment::_computeTypeRanges() {
+        // types of invalid segments may be out of range
+        for (size_t i = 0; i < this->m_RecordCount; ++i) {
+            const auto type = this->m_Records[i].type;
+            if (type >= TypeCount)
+                continue;
+            auto& range = this->m_TypeRanges[type];
+            if (range.first == range.second)
+                range.first = uint32_t(i);
+            range.second = uint32_t(i + 1);
+        }
+    }
+
+    VocabularyRef VocabularySegment::operator[](size_t idx) const {
+        assert(idx < this->m_RecordCount);
+        const auto& record = this->m_Records[idx];
+
+        VocabularyRef ref;
+        ref.type = Vocabulary::Type(record.type);
+        ref.frequency = uint8_t(record.frequency);
+        ref.kana = this->getString(record.kana);
+        ref.kanji = this->getString(record.kanji);
+        ref.english = VocabularyRef::EnglishRange(this, record.englishBegin,
+                                                  record.englishCount);
+        return ref;
+    }
+
+    bool VocabularySegment::isValid() const {
+        // ordered records are grouped by type as well
+        for (size_t i = 1; i < this->m_RecordCount; ++i) {
+            const auto& previous = this->m_Records[i - 1];
+            const auto& record = this->m_Records[i];
+            if (std::make_pair(record.type, record.frequency) <
+                std::make_pair(previous.type, previous.frequency)) {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < this->m_StringCount; ++i) {
+            const auto& str = this->m_Strings[i];
+            if (uint64_t(str.offset) + str.length > this->m_CharCount)
+                return false;
+        }
+        for (size_t i = 0; i < this->m_RecordCount; ++i) {
+            const auto& record = this->m_Records[i];
+            if (record.type > uint32_t(Vocabulary::Type::UNKNOWN) ||
+                record.frequency > Vocabulary::NoFrequency ||
+                record.kana >= this->m_StringCount ||
+                record.kanji >= this->m_StringCount ||
+                uint64_t(record.englishBegin) + record.englishCount >
+                    this->m_StringCount) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // namespace detail
@@ -0,0 +1,159 @@
+#include "detail/vocabsnapshot.h"
+
+#include <cstring>
+#include <fstream>
+
+#include "detail/util.hpp"
+
+namespace detail {
+
+    namespace snapshot {
+
+        static constexpr const char Magic[8] = {'J', 'A', 'V', 'O',
+                                                'C', 'S', 'N', 'P'};
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t charSize;
+            uint64_t fingerprint;
+            uint64_t entryCount;
+            uint64_t stringCount;
+            uint64_t charCount;
+            // checksum of everything following the header
+            uint64_t checksum;
+        };
+
+        // the arrays of a segment are stored as they are,
+        // so a loaded snapshot is used without any copy
+        using Entry = VocabularySegment::Record;
+        using StringRef = VocabularySegment::StringRef;
+
+        static_assert(sizeof(Header) % alignof(Entry) == 0);
+        static_assert(sizeof(Entry) % alignof(StringRef) == 0);
+        static_assert(sizeof(StringRef) % alignof(char) == 0);
+
+        static size_t payloadSize(const Header& header) {
+            return header.entryCount * sizeof(Entry) +
+                   header.stringCount * sizeof(StringRef) +
+                   header.charCount * sizeof(char);
+        }
+
+    } // namespace snapshot
+
+    uint64_t VocabularySnapshot::fingerprintFiles(
+        const std::vector<boost::filesystem::path>& files) {
+        uint64_t hash = util::fnv1a(&Version, sizeof(Version));
+        for (const auto& e : files) {
+            const auto name = e.filename().string();
+            hash = util::fnv1a(name.data(), name.size(), hash);
+
+            boost::system::error_code ec;
+            const int64_t size = int64_t(boost::filesystem::file_size(e, ec));
+            const int64_t time =
+                ec ? 0 : int64_t(boost::filesystem::last_write_time(e, ec));
+            const int64_t values[] = {ec ? -1 : size, ec ? -1 : time};
+            hash = util::fnv1a(values, sizeof(values), hash);
+        }
+        return hash;
+    }
+
+    std::optional<VocabularySegment>
+        VocabularySnapshot::read(const boost::filesystem::path& filePath,
+                                 uint64_t fingerprint) {
+        using namespace snapshot;
+
+        auto file = std::make_shared<const util::MemoryMappedFile>(
+            filePath.string());
+        if (!*file || file->size() < sizeof(Header))
+            return std::nullopt;
+
+        const auto& header = *reinterpret_cast<const Header*>(file->data());
+        if (header.entryCount > file->size() ||
+            header.stringCount > file->size() ||
+            header.charCount > file->size())
+            return std::nullopt;
+
+        if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+            header.version != Version || header.charSize != sizeof(char) ||
+            header.fingerprint != fingerprint ||
+            file->size() != sizeof(Header) + payloadSize(header)) {
+            return std::nullopt;
+        }
+
+        const auto payload = file->data() + sizeof(Header);
+        if (util::fnv1a(payload, payloadSize(header)) != header.checksum)
+            return std::nullopt;
+
+        const auto entries = reinterpret_cast<const Entry*>(payload);
+        const auto strings = reinterpret_cast<const StringRef*>(
+            entries + header.entryCount);
+        const auto chars =
+            reinterpret_cast<const char*>(strings + header.stringCount);
+
+        // the segment keeps the mapping alive
+        VocabularySegment segment(entries, header.entryCount, strings,
+                                  header.stringCount, chars, header.charCount,
+                                  std::move(file));
+        if (!segment.isValid())
+            return std::nullopt;
+
+        return segment;
+    }
+
+    bool VocabularySnapshot::write(const boost::filesystem::path& filePath,
+                                   const VocabularySegment& segment,
+                                   uint64_t fingerprint) {
+        using namespace snapshot;
+
+        Header header{};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.charSize = sizeof(char);
+        header.fingerprint = fingerprint;
+        header.entryCount = segment.size();
+        header.stringCount = segment.stringCount();
+        header.charCount = segment.charCount();
+
+        const auto entryBytes = segment.size() * sizeof(Entry);
+        const auto stringBytes = segment.stringCount() * sizeof(StringRef);
+        const auto charBytes = segment.charCount() * sizeof(char);
+        header.checksum = util::fnv1a(segment.records(), entryBytes);
+        header.checksum =
+            util::fnv1a(segment.strings(), stringBytes, header.checksum);
+        header.checksum =
+            util::fnv1a(segment.chars(), charBytes, header.checksum);
+
+        // write to a temporary file first, so a reader
+        // never sees a partially written snapshot
+        auto tmpPath = filePath;
+        tmpPath += ".tmp";
+        bool written = false;
+        {
+            std::ofstream file(tmpPath.string(),
+                               std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(segment.records()),
+                       std::streamsize(entryBytes));
+            file.write(reinterpret_cast<const char*>(segment.strings()),
+                       std::streamsize(stringBytes));
+            file.write(reinterpret_cast<const char*>(segment.chars()),
+                       std::streamsize(charBytes));
+            // closing flushes, which may fail as well
+            file.close();
+            written = bool(file);
+        }
+        boost::system::error_code ec;
+        if (!written) {
+            boost::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+        boost::filesystem::rename(tmpPath, filePath, ec);
+        if (ec) {
+            boost::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+} // namespace detail
@@ -0,0 +1,425 @@
+#include "detail/vocabstore.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include "detail/normalize.h"
+#include "detail/vocabsearch.hpp"
+
+namespace detail {
+
+    VocabularyId VocabularyStore::appendSegment(VocabularySegment segment,
+                                                bool buildIndices) {
+        const auto count = this->m_SegmentCount.load(std::memory_order_relaxed);
+        if (count >= MaxSegments)
+            throw std::length_error("Too many vocabulary segments");
+
+        const auto first = VocabularyId(this->size());
+        if (uint64_t(first) + segment.size() >=
+            std::numeric_limits<VocabularyId>::max()) {
+            throw std::length_error("Too many vocabularies");
+        }
+
+        this->m_Segments[count] = std::move(segment);
+        if (buildIndices)
+            this->_buildIndices(count);
+        this->m_SegmentEnd[count] =
+            first + VocabularyId(this->m_Segments[count].size());
+
+        // publish the segment, readers only ever look at published ones
+        this->m_SegmentCount.store(count + 1, std::memory_order_release);
+        return first;
+    }
+
+    size_t VocabularyStore::segmentCount() const {
+        return this->m_SegmentCount.load(std::memory_order_acquire);
+    }
+
+    void VocabularyStore::_buildIndices(size_t segmentIdx) const {
+        std::call_once(this->m_IndicesBuilt[segmentIdx], [this, segmentIdx]() {
+            const auto& segment = this->m_Segments[segmentIdx];
+            const auto& keys = this->m_EnglishKeys[segmentIdx] =
+                segment.englishKeys();
+            this->m_EnglishIndices[segmentIdx] = EnglishTokenIndex(keys);
+            this->m_KanaIndices[segmentIdx] = KanaSubstringIndex(segment);
+            this->m_KanjiIndices[segmentIdx] = KanjiIndex(segment);
+            this->m_KanaCompletions[segmentIdx] =
+                CompletionIndex(segment, CompletionIndex::Keys::Kana);
+            this->m_EnglishCompletions[segmentIdx] =
+                CompletionIndex(keys, CompletionIndex::Keys::English);
+        });
+    }
+
+    size_t VocabularyStore::_segmentOf(VocabularyId id) const {
+        size_t segmentIdx = 0;
+        for (const auto count = this->segmentCount();
+             segmentIdx < count && id >= this->m_SegmentEnd[segmentIdx];)
+            ++segmentIdx;
+
+        assert(segmentIdx < this->segmentCount());
+        return segmentIdx;
+    }
+
+    VocabularyId VocabularyStore::_segmentBegin(size_t segmentIdx) const {
+        return this->m_SegmentEnd[segmentIdx] -
+               VocabularyId(this->m_Segments[segmentIdx].size());
+    }
+
+    std::pair<VocabularyStore::const_iterator, VocabularyStore::const_iterator>
+        VocabularyStore::getSegment(size_t segmentIdx) const {
+        assert(segmentIdx < this->segmentCount());
+        return {const_iterator(this, this->_segmentBegin(segmentIdx)),
+                const_iterator(this, this->m_SegmentEnd[segmentIdx])};
+    }
+
+    std::pair<VocabularyStore::const_iterator, VocabularyStore::const_iterator>
+        VocabularyStore::getTypeRange(size_t segmentIdx,
+                                      Vocabulary::Type type) const {
+        assert(segmentIdx < this->segmentCount());
+        const auto first = this->_segmentBegin(segmentIdx);
+        const auto [begin, end] =
+            this->m_Segments[segmentIdx].getTypeRange(type);
+        return {const_iterator(this, first + begin),
+                const_iterator(this, first + end)};
+    }
+
+    size_t VocabularyStore::countByType(Vocabulary::Type type) const {
+        size_t count = 0;
+        for (size_t i = 0, segments = this->segmentCount(); i < segments; ++i) {
+            const auto [begin, end] = this->m_Segments[i].getTypeRange(type);
+            count += end - begin;
+        }
+        return count;
+    }
+
+    VocabularyStore::const_iterator
+        VocabularyStore::getByType(Vocabulary::Type type, size_t n) const {
+        for (size_t i = 0, segments = this->segmentCount(); i < segments; ++i) {
+            const auto [begin, end] = this->m_Segments[i].getTypeRange(type);
+            if (n < end - begin)
+                return const_iterator(
+                    this, this->_segmentBegin(i) + begin + VocabularyId(n));
+            n -= end - begin;
+        }
+        assert(false);
+        return this->end();
+    }
+
+    size_t VocabularyStore::size() const {
+        const auto count = this->segmentCount();
+        return count ? this->m_SegmentEnd[count - 1] : 0;
+    }
+
+    bool VocabularyStore::empty() const { return this->size() == 0; }
+
+    VocabularyRef VocabularyStore::operator[](VocabularyId id) const {
+        const auto segmentIdx = this->_segmentOf(id);
+        return this->m_Segments[segmentIdx][id -
+                                            this->_segmentBegin(segmentIdx)];
+    }
+
+    VocabularyStore::const_iterator VocabularyStore::begin() const {
+        return const_iterator(this, 0);
+    }
+
+    VocabularyStore::const_iterator VocabularyStore::end() const {
+        return const_iterator(this, VocabularyId(this->size()));
+    }
+
+    VocabularyStore::const_iterator VocabularyStore::cbegin() const {
+        return this->begin();
+    }
+
+    VocabularyStore::const_iterator VocabularyStore::cend() const {
+        return this->end();
+    }
+
+    namespace {
+        // up to 'limit' distinct vocabularies of a segment having a key
+        // equal to 'key', the index ignores the case, so 'isExact' decides,
+        // keys of the same text are in id order and so in rank order
+        template <typename _ExactFunction>
+        void appendExact(const VocabularyStore& store, VocabularyId first,
+                         const CompletionIndex& index, std::string_view key,
+                         _ExactFunction&& isExact, size_t limit,
+                         std::vector<VocabularyStore::const_iterator>& result) {
+            const auto [begin, end] = index.equalRange(key);
+            VocabularyId previous = std::numeric_limits<VocabularyId>::max();
+            for (auto pos = begin; pos != end && limit != 0; ++pos) {
+                const auto id = first + index.getId(pos);
+                const VocabularyStore::const_iterator iter(&store, id);
+                if (id == previous || !isExact(iter))
+                    continue;
+                result.push_back(iter);
+                previous = id;
+                --limit;
+            }
+        }
+    } // namespace
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::findAllEnglish(std::string_view english,
+                                        size_t limit) const {
+        // keys consist of single space separated words only, which are
+        // exactly the tokens of the index
+        std::string buffer;
+        english = normalizeEnglish(english, buffer);
+        if (english.empty())
+            return {};
+
+        const bool singleToken = english.find(' ') == std::string_view::npos;
+        const auto isExact = [this, english](const_iterator iter) {
+            const auto keys = this->getEnglishKeys(iter.id());
+            return std::find(keys.begin(), keys.end(), english) != keys.end();
+        };
+        std::vector<const_iterator> result;
+        for (size_t i = 0, count = this->segmentCount(); i < count && limit;
+             ++i) {
+            this->_buildIndices(i);
+            const auto& index = this->m_EnglishIndices[i];
+            const auto first = this->_segmentBegin(i);
+
+            // ids are in rank order, so the first 'limit' exact and the
+            // first 'limit' other matches are the best ones of the segment
+            appendExact(*this, first, this->m_EnglishCompletions[i], english,
+                        isExact, limit, result);
+            size_t others = 0;
+            auto append = [&](VocabularyId id) {
+                const const_iterator iter(this, first + id);
+                if (!isExact(iter)) {
+                    result.push_back(iter);
+                    ++others;
+                }
+                return others < limit;
+            };
+            if (singleToken) {
+                for (auto [iter, end] = index.find(english);
+                     iter != end && append(*iter); ++iter) {
+                }
+                continue;
+            }
+            // all words are contained, but maybe not next to each other
+            const auto& keys = this->m_EnglishKeys[i];
+            for (const auto id : index.intersect(english)) {
+                if (impl::_matchesEnglish(keys[id], english) && !append(id))
+                    break;
+            }
+        }
+        impl::_orderFindResult(result, isExact, limit);
+        return result;
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::findExactEnglish(std::string_view english,
+                                          size_t limit) const {
+        std::string buffer;
+        english = normalizeEnglish(english, buffer);
+        if (english.empty())
+            return {};
+
+        const auto isExact = [](const_iterator) { return true; };
+        std::vector<const_iterator> result;
+        for (size_t i = 0, count = this->segmentCount(); i < count && limit;
+             ++i) {
+            this->_buildIndices(i);
+            appendExact(*this, this->_segmentBegin(i),
+                        this->m_EnglishCompletions[i], english, isExact, limit,
+                        result);
+        }
+        impl::_orderFindResult(result, isExact, limit);
+        return result;
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::findAllKana(std::string_view kana,
+                                     size_t limit) const {
+        // an empty string is part of every reading
+        if (kana.empty())
+            return impl::_findAllKana<const_iterator>(*this, kana, limit);
+
+        const auto isExact = impl::_exactKanaPartition<const_iterator>(kana);
+        std::vector<const_iterator> result;
+        for (size_t i = 0, count = this->segmentCount(); i < count && limit;
+             ++i) {
+            this->_buildIndices(i);
+            const auto first = this->_segmentBegin(i);
+            const auto& completions = this->m_KanaCompletions[i];
+            appendExact(*this, first, completions, kana, isExact, limit,
+                        result);
+
+            // the smallest ids contain the best 'limit' others
+            // as soon as all exact matches are skipped
+            const auto [begin, end] = completions.equalRange(kana);
+            const auto exact = end - begin;
+            const auto wanted =
+                limit > NoLimit - exact ? NoLimit : limit + exact;
+            size_t others = 0;
+            for (const auto id : this->m_KanaIndices[i].find(kana, wanted)) {
+                if (others == limit)
+                    break;
+                const const_iterator iter(this, first + id);
+                if (!isExact(iter)) {
+                    result.push_back(iter);
+                    ++others;
+                }
+            }
+        }
+        impl::_orderFindResult(result, isExact, limit);
+        return result;
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::findAllKanji(std::string_view kanji,
+                                      size_t limit) const {
+        auto isExact = [kanji](const_iterator iter) {
+            return iter->kanji == kanji;
+        };
+        std::vector<const_iterator> result;
+        for (size_t i = 0, count = this->segmentCount(); i < count && limit;
+             ++i) {
+            this->_buildIndices(i);
+            const auto first = this->_segmentBegin(i);
+
+            // every exact spelling, but only the first 'limit' others
+            size_t others = 0;
+            for (const auto id : this->m_KanjiIndices[i].intersect(kanji)) {
+                const const_iterator iter(this, first + id);
+                if (isExact(iter))
+                    result.push_back(iter);
+                else if (others < limit) {
+                    result.push_back(iter);
+                    ++others;
+                }
+            }
+        }
+        impl::_orderFindResult(result, isExact, limit);
+        return result;
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::completeKana(std::string_view prefix,
+                                      size_t limit) const {
+        return this->_complete(this->m_KanaCompletions, prefix, limit);
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::completeEnglish(std::string_view prefix,
+                                         size_t limit) const {
+        std::string buffer;
+        return this->_complete(this->m_EnglishCompletions,
+                               normalizeEnglish(prefix, buffer), limit);
+    }
+
+    std::vector<VocabularyStore::const_iterator> VocabularyStore::_complete(
+        const std::array<CompletionIndex, MaxSegments>& indices,
+        std::string_view prefix, size_t limit) const {
+        // the best 'limit' of every segment, merged by rank,
+        // segments are in id order so equal ranks stay ordered by id
+        std::vector<std::pair<uint64_t, VocabularyId>> candidates;
+        for (size_t i = 0, count = this->segmentCount(); i < count; ++i) {
+            this->_buildIndices(i);
+            const auto first = this->_segmentBegin(i);
+            for (const auto& e : indices[i].complete(prefix, limit))
+                candidates.emplace_back(e.rank, first + e.id);
+        }
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const auto& lhs, const auto& rhs) {
+                             return lhs.first < rhs.first;
+                         });
+
+        std::vector<const_iterator> result;
+        for (size_t i = 0; i < candidates.size() && i < limit; ++i)
+            result.emplace_back(this, candidates[i].second);
+        return result;
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::findSimilarKana(std::string_view kana,
+                                         uint32_t maxDistance) const {
+        return this->_findSimilar(this->m_KanaCompletions, kana, maxDistance);
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::findSimilarEnglish(std::string_view english,
+                                            uint32_t maxDistance) const {
+        std::string buffer;
+        return this->_findSimilar(this->m_EnglishCompletions,
+                                  normalizeEnglish(english, buffer),
+                                  maxDistance);
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::_findSimilar(
+            const std::array<CompletionIndex, MaxSegments>& indices,
+            std::string_view query, uint32_t maxDistance) const {
+        std::vector<std::pair<uint32_t, const_iterator>> matches;
+        for (size_t i = 0, count = this->segmentCount(); i < count; ++i) {
+            this->_buildIndices(i);
+            const auto first = this->_segmentBegin(i);
+            for (const auto& e : indices[i].findSimilar(query, maxDistance))
+                matches.emplace_back(e.distance,
+                                     const_iterator(this, first + e.id));
+        }
+        // ids are ascending, a stable sort keeps them for equal ranks
+        std::stable_sort(matches.begin(), matches.end(),
+                         [](const auto& lhs, const auto& rhs) {
+                             if (lhs.first != rhs.first)
+                                 return lhs.first < rhs.first;
+                             return int(lhs.second->type) <
+                                    int(rhs.second->type);
+                         });
+
+        std::vector<const_iterator> result;
+        result.reserve(matches.size());
+        for (const auto& e : matches)
+            result.push_back(e.second);
+        return result;
+    }
+
+    std::optional<VocabularyId>
+        VocabularyStore::findId(const Vocabulary& voc) const {
+        for (size_t i = 0, count = this->segmentCount(); i < count; ++i) {
+            this->_buildIndices(i);
+            const auto& index = this->m_KanaCompletions[i];
+            const auto first = this->_segmentBegin(i);
+            for (auto [pos, end] = index.equalRange(voc.kana); pos != end;
+                 ++pos) {
+                const auto id = first + index.getId(pos);
+                if ((*this)[id] == voc)
+                    return id;
+            }
+        }
+        return std::nullopt;
+    }
+
+    VocabularyRef::EnglishRange
+        VocabularyStore::getEnglishKeys(VocabularyId id) const {
+        const auto segmentIdx = this->_segmentOf(id);
+        this->_buildIndices(segmentIdx);
+        return this->m_EnglishKeys[segmentIdx][id -
+                                               this->_segmentBegin(segmentIdx)]
+            .english;
+    }
+
+    std::vector<VocabularyStore::const_iterator>
+        VocabularyStore::findAllByType(Vocabulary::Type type) const {
+        // the ranges are already in id order, no need to sort them
+        std::vector<const_iterator> result;
+        result.reserve(this->countByType(type));
+        for (size_t i = 0, count = this->segmentCount(); i < count; ++i) {
+            for (auto [iter, end] = this->getTypeRange(i, type); iter != end;
+                 ++iter) {
+                result.push_back(iter);
+            }
+        }
+        return result;
+    }
+
+    std::vector<VocabularyStore::const_iterator> VocabularyStore::findAllIf(
+        std::function<bool(const VocabularyRef&)> predicate) const {
+        auto partitionFunc = [](const auto&) { return true; };
+        return impl::_findAll<const_iterator>(*this, predicate, partitionFunc);
+    }
+
+} // namespace detail
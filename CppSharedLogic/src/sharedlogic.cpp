@@ -7,14 +7,21 @@
 #include <random>
 #include <sqlite3.h>
 #include <sstream>
+#include <stdexcept>
 
+#include "detail/normalize.h"
+#include "detail/romaji.h"
+#include "detail/threadpool.h"
 #include "detail/util.hpp"
+#include "detail/vocabsearch.hpp"
+#include "detail/vocabsnapshot.h"
 
 namespace parameter {
 
     static constexpr const std::wstring_view VocabularyDeck_Exstension = L".vd";
 
     static constexpr const auto FileName_Jmdict = "JMdict_e";
+    static constexpr const auto FileName_AnkiSnapshot = "anki.snapshot";
 
     static constexpr const auto PostFix_Anki_KanjiEnglish =
         "-vocab-kanji-eng.anki";
@@ -50,8 +57,10 @@ namespace shared {
             auto rng_iter = detail::util::getRandomIterator(
                 voc.english.cbegin(), voc.english.cend());
 
-            return Question(Question::KeyboardType::English, *rng_iter,
-                            {voc.kana}, std::move(acceptCallback));
+            return Question(Question::KeyboardType::English,
+                            detail::convertUtf8Wstring(*rng_iter),
+                            {detail::convertUtf8Wstring(voc.kana)},
+                            std::move(acceptCallback));
         }
         static Question ConvertVocabularyToQuestion_KanaToEnglish(
             std::function<void(bool)> acceptCallback,
@@ -59,8 +68,10 @@ namespace shared {
             auto rng_iter = detail::util::getRandomIterator(
                 voc.english.cbegin(), voc.english.cend());
 
-            return Question(Question::KeyboardType::English, *rng_iter,
-                            {voc.kana}, std::move(acceptCallback));
+            return Question(Question::KeyboardType::English,
+                            detail::convertUtf8Wstring(*rng_iter),
+                            {detail::convertUtf8Wstring(voc.kana)},
+                            std::move(acceptCallback));
         }
         static Question ConvertVocabularyToQuestion_Mixed(
             std::function<void(bool)> acceptCallback,
@@ -187,8 +198,8 @@ namespace shared {
         assert(fc);
 
         using Fc = VocabularyDeck::Flashcard;
-        auto update = [this, iter = fc->vocIter](Fc::index_type newIdx) {
-            this->m_VocabularyMaanger->setFlashcardIndex(iter, newIdx);
+        auto update = [this, vocId = fc->vocId](Fc::index_type newIdx) {
+            this->m_VocabularyMaanger->setFlashcardIndex(vocId, newIdx);
         };
         if (accept && fc->cardIndex > Fc::MIN_CARD_INDEX)
             update(fc->cardIndex - 1);
@@ -258,95 +269,538 @@ namespace shared {
         throw std::runtime_error("Not implemented yet!");
     }
 
-    std::wstring VocabularyTranslator::translateEnglish(const std::wstring &english) const
-    {
-        const auto voc = this->m_VocabularyMaanger.findAllEnglish(english);
-        std::vector<std::wstring> tmpContainer(voc.size());
+    // one line per vocabulary holding its kana
+    static std::wstring joinKana(
+        const std::vector<detail::VocabularyStore::const_iterator>& voc) {
+        std::vector<std::string_view> tmpContainer(voc.size());
         std::transform(voc.cbegin(), voc.cend(), tmpContainer.begin(),
-                       [](detail::VocabularyVector::const_iterator iter) {
+                       [](detail::VocabularyStore::const_iterator iter) {
                            return iter->kana;
                        });
-        return detail::util::combineWStringContainerToWstring(tmpContainer,
-                                                              L"\n");
+        return detail::convertUtf8Wstring(
+            detail::util::combineStringContainerToString(tmpContainer, "\n"));
+    }
+
+    // one line per vocabulary holding all its english translations
+    static std::wstring joinEnglish(
+        const std::vector<detail::VocabularyStore::const_iterator>& voc) {
+        std::vector<std::string> tmpContainer(voc.size());
+        std::transform(
+            voc.cbegin(), voc.cend(), tmpContainer.begin(),
+            [](detail::VocabularyStore::const_iterator iter) {
+                return detail::util::combineStringContainerToString(
+                    iter->english);
+            });
+        return detail::convertUtf8Wstring(
+            detail::util::combineStringContainerToString(tmpContainer, "\n"));
+    }
+
+    // one line per vocabulary holding its kanji, kana and translations
+    static std::wstring joinVocabulary(
+        const std::vector<detail::VocabularyStore::const_iterator>& voc) {
+        std::vector<std::string> tmpContainer(voc.size());
+        std::transform(
+            voc.cbegin(), voc.cend(), tmpContainer.begin(),
+            [](detail::VocabularyStore::const_iterator iter) {
+                return std::string(iter->kanji) + " " +
+                       std::string(iter->kana) + "\t" +
+                       detail::util::combineStringContainerToString(
+                           iter->english);
+            });
+        return detail::convertUtf8Wstring(
+            detail::util::combineStringContainerToString(tmpContainer, "\n"));
+    }
+
+    // segments are only appended, so the store size
+    // identifies the vocabulary a result was computed from
+    template <typename _Compute>
+    std::wstring VocabularyTranslator::_cached(detail::QueryCache::Kind kind,
+                                               size_t parameter,
+                                               std::string_view query,
+                                               _Compute&& compute) const {
+        const detail::QueryCache::Key key{
+            kind, uint32_t(std::min<size_t>(parameter, UINT32_MAX)), query};
+        return this->m_Cache.get(key, this->m_VocabularyMaanger.size(),
+                                 std::forward<_Compute>(compute));
+    }
+
+    std::wstring VocabularyTranslator::translateEnglish(const std::wstring &english,
+                                                        size_t limit) const
+    {
+        // the store is utf-8, only the query and the result are converted,
+        // queries with the same key share their cache entry
+        const auto utf8 = detail::convertWstringUtf8(english);
+        std::string buffer;
+        const auto key = detail::normalizeEnglish(utf8, buffer);
+        return this->_cached(detail::QueryCache::Kind::English, limit, key,
+                             [&]() {
+                                 return joinKana(
+                                     this->m_VocabularyMaanger.findAllEnglish(
+                                         key, limit));
+                             });
+    }
+
+    std::wstring VocabularyTranslator::translateKanji(const std::wstring& kanji,
+                                                      size_t limit) const {
+        const auto utf8 = detail::convertWstringUtf8(kanji);
+        return this->_cached(detail::QueryCache::Kind::Kanji, limit, utf8,
+                             [&]() {
+                                 return joinVocabulary(
+                                     this->m_VocabularyMaanger.findAllKanji(
+                                         utf8, limit));
+                             });
+    }
+
+    std::wstring VocabularyTranslator::translateSimilarEnglish(
+        const std::wstring& english, unsigned maxDistance) const {
+        const auto utf8 = detail::convertWstringUtf8(english);
+        std::string buffer;
+        const auto key = detail::normalizeEnglish(utf8, buffer);
+        return this->_cached(
+            detail::QueryCache::Kind::SimilarEnglish, maxDistance, key,
+            [&]() {
+                return joinKana(this->m_VocabularyMaanger.findSimilarEnglish(
+                    key, maxDistance));
+            });
+    }
+
+    uint64_t VocabularyTranslator::getCacheHits() const {
+        return this->m_Cache.hits();
+    }
+
+    uint64_t VocabularyTranslator::getCacheMisses() const {
+        return this->m_Cache.misses();
+    }
+
+    void VocabularyTranslator::clearCache() const { this->m_Cache.clear(); }
+
+    // distinct keys of the best completions, vocabularies may share
+    // a key, so more are requested until there are 'limit' keys
+    template <typename _CompleteFunction, typename _KeyFunction>
+    static std::vector<std::wstring>
+        completeDistinct(size_t limit, _CompleteFunction&& completeFunc,
+                         _KeyFunction&& keyFunc) {
+        std::vector<std::wstring> result;
+        for (size_t requested = limit; result.size() < limit;
+             requested *= 2) {
+            const auto vocs = completeFunc(requested);
+            result.clear();
+            for (const auto iter : vocs) {
+                auto key = detail::convertUtf8Wstring(keyFunc(iter));
+                if (std::find(result.begin(), result.end(), key) ==
+                    result.end()) {
+                    result.push_back(std::move(key));
+                }
+                if (result.size() == limit)
+                    break;
+            }
+            if (vocs.size() < requested)
+                break;
+        }
+        return result;
+    }
+
+    std::vector<std::wstring>
+        VocabularyTranslator::completeKana(const std::wstring& prefix,
+                                           size_t limit) const {
+        const auto utf8 = detail::convertWstringUtf8(prefix);
+        return completeDistinct(
+            limit,
+            [&](size_t requested) {
+                return this->m_VocabularyMaanger.completeKana(utf8, requested);
+            },
+            [](detail::VocabularyStore::const_iterator iter) {
+                return iter->kana;
+            });
+    }
+
+    std::vector<std::wstring>
+        VocabularyTranslator::completeEnglish(const std::wstring& prefix,
+                                              size_t limit) const {
+        const auto utf8 = detail::convertWstringUtf8(prefix);
+        std::string buffer;
+        const auto key = detail::normalizeEnglish(utf8, buffer);
+        const auto& store = this->m_VocabularyMaanger;
+        return completeDistinct(
+            limit,
+            [&](size_t requested) {
+                return store.completeEnglish(key, requested);
+            },
+            // the translation which has been matched, as it is written
+            [&](detail::VocabularyStore::const_iterator iter) {
+                const auto keys = store.getEnglishKeys(iter.id());
+                const auto match = std::find_if(
+                    keys.begin(), keys.end(), [&](std::string_view e) {
+                        return detail::CompletionIndex::startsWith(e, key);
+                    });
+                return iter->english[size_t(match - keys.begin())];
+            });
     }
 
     VocabularyTranslator::VocabularyTranslator(
-        const detail::VocabularyVector& manager)
+        const detail::VocabularyStore& manager)
         : m_VocabularyMaanger(manager) {}
 
-    std::wstring VocabularyTranslator::translateKana(const std::wstring &kana) const
+    // romaji is searched as hiragana and as katakana
+    static std::vector<detail::VocabularyStore::const_iterator>
+        findAllKanaOrRomaji(const detail::VocabularyStore& store,
+                            const std::string& kana, size_t limit) {
+        if (!detail::isRomaji(kana))
+            return store.findAllKana(kana, limit);
+
+        const auto hiragana = detail::convertRomajiToKana(kana);
+        const auto katakana = detail::convertRomajiToKana(
+            kana, detail::KanaScript::Katakana);
+        auto result = store.findAllKana(hiragana, limit);
+        const auto katakanaResult = store.findAllKana(katakana, limit);
+        result.insert(result.end(), katakanaResult.begin(),
+                      katakanaResult.end());
+        detail::impl::_orderFindResult(
+            result,
+            [&](detail::VocabularyStore::const_iterator iter) {
+                return iter->kana == hiragana || iter->kana == katakana;
+            },
+            limit);
+        return result;
+    }
+
+    std::wstring VocabularyTranslator::translateKana(const std::wstring &kana,
+                                                     size_t limit) const
     {
-        const auto voc = this->m_VocabularyMaanger.findAllKana(kana);
-        std::vector<std::wstring> tmpContainer(voc.size());
-        std::transform(
-            voc.cbegin(), voc.cend(), tmpContainer.begin(),
-            [](detail::VocabularyVector::const_iterator iter) {
-                return detail::util::combineWStringContainerToWstring(
-                    iter->english);
+        const auto utf8 = detail::convertWstringUtf8(kana);
+        return this->_cached(detail::QueryCache::Kind::Kana, limit, utf8,
+                             [&]() {
+                                 return joinEnglish(findAllKanaOrRomaji(
+                                     this->m_VocabularyMaanger, utf8, limit));
+                             });
+    }
+
+    std::wstring VocabularyTranslator::translateSimilarKana(
+        const std::wstring& kana, unsigned maxDistance) const {
+        const auto utf8 = detail::convertWstringUtf8(kana);
+        return this->_cached(
+            detail::QueryCache::Kind::SimilarKana, maxDistance, utf8,
+            [&]() {
+                return joinEnglish(this->m_VocabularyMaanger.findSimilarKana(
+                    utf8, maxDistance));
             });
-        return detail::util::combineWStringContainerToWstring(tmpContainer,
-                                                              L"\n");
     }
 
-    static detail::VocabularyVector
-        readAnkiFromBasepathAndPrefix(const boost::filesystem::path& basepath,
-                                      const std::string& prefix) {
-        const auto kanji_english_filepath =
-            basepath / (prefix + parameter::PostFix_Anki_KanjiEnglish);
+    size_t SearchResult::size() const { return this->m_Ids.size(); }
 
-        const auto kanji_hiragana_filepath =
-            basepath / (prefix + parameter::PostFix_Anki_KanjiHiragana);
+    bool SearchResult::empty() const { return this->m_Ids.empty(); }
 
-        if (!boost::filesystem::exists(kanji_english_filepath) ||
-            !boost::filesystem::exists(kanji_hiragana_filepath)) {
-            return {};
+    detail::VocabularyId SearchResult::getId(size_t idx) const {
+        return this->m_Ids[idx];
+    }
+
+    const std::vector<detail::VocabularyId>& SearchResult::getIds() const {
+        return this->m_Ids;
+    }
+
+    size_t SearchResult::copyIds(int32_t* ids, size_t capacity) const {
+        const auto count = std::min(capacity, this->m_Ids.size());
+        std::copy_n(this->m_Ids.begin(), count, ids);
+        return count;
+    }
+
+    SearchResult VocabularyTranslator::_toSearchResult(
+        const std::vector<detail::VocabularyStore::const_iterator>& vocs) {
+        SearchResult result;
+        result.m_Ids.reserve(vocs.size());
+        for (const auto& e : vocs)
+            result.m_Ids.push_back(e.id());
+        return result;
+    }
+
+    SearchResult VocabularyTranslator::searchKana(const std::wstring& kana,
+                                                  size_t limit) const {
+        return _toSearchResult(findAllKanaOrRomaji(
+            this->m_VocabularyMaanger, detail::convertWstringUtf8(kana),
+            limit));
+    }
+
+    SearchResult
+        VocabularyTranslator::searchEnglish(const std::wstring& english,
+                                            size_t limit) const {
+        return _toSearchResult(this->m_VocabularyMaanger.findAllEnglish(
+            detail::convertWstringUtf8(english), limit));
+    }
+
+    SearchResult VocabularyTranslator::searchKanji(const std::wstring& kanji,
+                                                   size_t limit) const {
+        return _toSearchResult(this->m_VocabularyMaanger.findAllKanji(
+            detail::convertWstringUtf8(kanji), limit));
+    }
+
+    detail::VocabularyRef
+        VocabularyTranslator::_vocabulary(detail::VocabularyId id) const {
+        if (id >= this->m_VocabularyMaanger.size())
+            throw std::out_of_range("Unknown vocabulary id: " +
+                                    std::to_string(id));
+        return this->m_VocabularyMaanger[id];
+    }
+
+    std::wstring VocabularyTranslator::getKana(detail::VocabularyId id) const {
+        return detail::convertUtf8Wstring(this->_vocabulary(id).kana);
+    }
+
+    std::wstring VocabularyTranslator::getKanji(detail::VocabularyId id) const {
+        return detail::convertUtf8Wstring(this->_vocabulary(id).kanji);
+    }
+
+    size_t
+        VocabularyTranslator::getEnglishCount(detail::VocabularyId id) const {
+        return this->_vocabulary(id).english.size();
+    }
+
+    std::wstring VocabularyTranslator::getEnglish(detail::VocabularyId id,
+                                                  size_t n) const {
+        const auto english = this->_vocabulary(id).english;
+        if (n >= english.size())
+            throw std::out_of_range("Unknown translation: " +
+                                    std::to_string(n));
+        return detail::convertUtf8Wstring(english[n]);
+    }
+
+    detail::Vocabulary::Type
+        VocabularyTranslator::getType(detail::VocabularyId id) const {
+        return this->_vocabulary(id).type;
+    }
+
+    size_t TranslationBatch::size() const {
+        return this->m_Offsets.size() - 1;
+    }
+
+    size_t TranslationBatch::count(size_t query) const {
+        return this->m_Offsets[query + 1] - this->m_Offsets[query];
+    }
+
+    detail::VocabularyId TranslationBatch::getId(size_t query,
+                                                 size_t n) const {
+        assert(n < this->count(query));
+        return this->m_Ids[this->m_Offsets[query] + n];
+    }
+
+    const std::vector<detail::VocabularyId>& TranslationBatch::getIds() const {
+        return this->m_Ids;
+    }
+
+    const std::vector<size_t>& TranslationBatch::getOffsets() const {
+        return this->m_Offsets;
+    }
+
+    template <typename _Find>
+    TranslationBatch VocabularyTranslator::_translateBatch(
+        const std::vector<std::wstring>& queries, _Find&& find) const {
+        // every chunk collects its ids in a buffer of its own, they are
+        // appended in query order once all of them are done
+        struct Chunk {
+            std::vector<detail::VocabularyId> ids;
+            std::vector<size_t> counts;
+        };
+        const auto translateChunk = [&queries, &find](size_t begin,
+                                                      size_t end) {
+            Chunk chunk;
+            chunk.counts.reserve(end - begin);
+            for (size_t i = begin; i < end; ++i) {
+                const auto result =
+                    find(detail::convertWstringUtf8(queries[i]));
+                for (const auto& e : result)
+                    chunk.ids.push_back(e.id());
+                chunk.counts.push_back(result.size());
+            }
+            return chunk;
+        };
+
+        std::call_once(this->m_PoolStarted, [this]() {
+            this->m_Pool = std::make_unique<detail::util::ThreadPool>();
+        });
+
+        // a few chunks per thread, queries differ a lot in cost
+        const size_t chunkSize =
+            queries.size() / (this->m_Pool->size() * 4) + 1;
+        std::vector<std::future<Chunk>> chunks;
+        // the chunks reference 'translateChunk' and the queries, so none may
+        // still be running once this returns or throws
+        struct WaitForChunks {
+            std::vector<std::future<Chunk>>& chunks;
+            ~WaitForChunks() {
+                for (auto& e : this->chunks) {
+                    if (e.valid())
+                        e.wait();
+                }
+            }
+        } waitForChunks{chunks};
+        for (size_t begin = 0; begin < queries.size(); begin += chunkSize) {
+            const auto end = std::min(begin + chunkSize, queries.size());
+            chunks.push_back(this->m_Pool->submit(
+                [&translateChunk, begin, end]() {
+                    return translateChunk(begin, end);
+                }));
+        }
+
+        TranslationBatch batch;
+        batch.m_Offsets.reserve(queries.size() + 1);
+        for (auto& e : chunks) {
+            const auto chunk = e.get();
+            batch.m_Ids.insert(batch.m_Ids.end(), chunk.ids.begin(),
+                               chunk.ids.end());
+            for (const auto count : chunk.counts)
+                batch.m_Offsets.push_back(batch.m_Offsets.back() + count);
         }
-        const auto result = detail::VocParser::parseAnkiDataBase(
-            kanji_english_filepath, kanji_hiragana_filepath);
+        return batch;
+    }
 
-        return result ? *result : detail::VocabularyVector();
+    TranslationBatch VocabularyTranslator::translateKanaBatch(
+        const std::vector<std::wstring>& kana, size_t limit) const {
+        const auto& store = this->m_VocabularyMaanger;
+        return this->_translateBatch(kana, [&store, limit](const auto& query) {
+            return findAllKanaOrRomaji(store, query, limit);
+        });
+    }
+
+    TranslationBatch VocabularyTranslator::translateEnglishBatch(
+        const std::vector<std::wstring>& english, size_t limit) const {
+        const auto& store = this->m_VocabularyMaanger;
+        return this->_translateBatch(english,
+                                     [&store, limit](const auto& query) {
+                                         return store.findAllEnglish(query,
+                                                                     limit);
+                                     });
+    }
+
+    static std::pair<boost::filesystem::path, boost::filesystem::path>
+        ankiFilepathsFromPrefix(const boost::filesystem::path& basepath,
+                                const std::string& prefix) {
+        return {basepath / (prefix + parameter::PostFix_Anki_KanjiEnglish),
+                basepath / (prefix + parameter::PostFix_Anki_KanjiHiragana)};
     }
 
     static detail::VocabularyVector
         parseAnkiData(const boost::filesystem::path& basepath) {
-        detail::VocabularyVector result;
+        using Parser = detail::VocParser;
+        using Cards = std::vector<detail::AnkiParseResult>;
+        struct Level {
+            detail::Vocabulary::Type type;
+            std::future<Cards> kanjiEnglish;
+            std::future<Cards> kanjiHiragana;
+            std::future<std::optional<detail::VocabularyVector>> merged;
+        };
+
+        // all databases are independent of each other, read and merge them
+        // in parallel but always combine the levels in prefix order
+        detail::util::ThreadPool pool;
+        std::vector<Level> levels;
         for (const auto& e : parameter::VocabularyType_Prefix) {
-            auto anki = readAnkiFromBasepathAndPrefix(basepath, e.second);
-            for (auto& voc : anki)
-                voc.type = e.first;
+            auto [kanji_english_filepath, kanji_hiragana_filepath] =
+                ankiFilepathsFromPrefix(basepath, e.second);
+
+            if (!boost::filesystem::exists(kanji_english_filepath) ||
+                !boost::filesystem::exists(kanji_hiragana_filepath)) {
+                continue;
+            }
+            auto& level = levels.emplace_back();
+            level.type = e.first;
+            level.kanjiEnglish = pool.submit([path = kanji_english_filepath]() {
+                return Parser::readAnkiDataBaseSorted(path);
+            });
+            level.kanjiHiragana =
+                pool.submit([path = kanji_hiragana_filepath]() {
+                    return Parser::readAnkiDataBaseSorted(path);
+                });
+        }
+        for (auto& e : levels) {
+            e.merged = pool.submit(
+                [eng = e.kanjiEnglish.get(), hira = e.kanjiHiragana.get()]() {
+                    return Parser::mergeAnkiDataBases(eng, hira);
+                });
+        }
+
+        detail::VocabularyVector result;
+        for (auto& e : levels) {
+            auto anki = e.merged.get();
+            if (!anki)
+                continue;
+
+            for (auto& voc : *anki)
+                voc.type = e.type;
 
-            result.insert(result.end(), anki.cbegin(), anki.cend());
+            result.insert(result.end(), std::make_move_iterator(anki->begin()),
+                          std::make_move_iterator(anki->end()));
         }
         return result;
     }
 
-    static detail::VocabularyVector
-        parseJmdictData(const boost::filesystem::path& basepath, bool enable) {
-        if (!enable)
-            return {};
+    static detail::VocabularySegment
+        loadAnkiData(const boost::filesystem::path& basepath) {
+        std::vector<boost::filesystem::path> sources;
+        for (const auto& e : parameter::VocabularyType_Prefix) {
+            const auto paths = ankiFilepathsFromPrefix(basepath, e.second);
+            sources.push_back(paths.first);
+            sources.push_back(paths.second);
+        }
 
-        const auto parsed = detail::VocParser::parseJMDictFile(
-            basepath / parameter::FileName_Jmdict);
+        // use the snapshot as long as none of the databases changed,
+        // otherwise parse them and rebuild it
+        using Snapshot = detail::VocabularySnapshot;
+        const auto snapshotPath = basepath / parameter::FileName_AnkiSnapshot;
+        const auto fingerprint = Snapshot::fingerprintFiles(sources);
+        if (auto snapshot = Snapshot::read(snapshotPath, fingerprint))
+            return std::move(*snapshot);
 
-        return parsed ? *parsed : detail::VocabularyVector();
-    }
+        detail::VocabularySegment result(parseAnkiData(basepath));
+        if (!result.empty())
+            (void)Snapshot::write(snapshotPath, result, fingerprint);
 
-    detail::VocabularyVector combineVocs(const detail::VocabularyVector& v0,
-                                         const detail::VocabularyVector& v1) {
-        detail::VocabularyVector result = v0;
-        result.insert(result.end(), v1.cbegin(), v1.cend());
         return result;
     }
 
+    static detail::VocabularyVector
+        parseJmdictData(const boost::filesystem::path& basepath) {
+        auto parsed = detail::VocParser::parseJMDictFileParallel(
+            basepath / parameter::FileName_Jmdict);
+
+        return parsed ? std::move(*parsed) : detail::VocabularyVector();
+    }
+
     LogicHandler::LogicHandler(const std::string &databasesDirectory,
                                const std::string &userFilePath,
                                bool enableJmdict)
-        : m_Translator(this->m_AllVocabulary), m_UserFilePath(userFilePath),
-          m_AnkiVocabulary(parseAnkiData(databasesDirectory)),
-          m_JmdictVocabulary(parseJmdictData(databasesDirectory, enableJmdict)),
-          m_AllVocabulary(combineVocs(this->m_AnkiVocabulary, this->m_JmdictVocabulary))
+        : m_Translator(this->m_Vocabulary), m_UserFilePath(userFilePath)
     {
+        this->m_Vocabulary.appendSegment(loadAnkiData(databasesDirectory));
         this->m_CurrentDeck = std::make_shared<VocabularyDeck>(this->m_UserFilePath.string());
+
+        if (!enableJmdict) {
+            std::promise<void> ready;
+            ready.set_value();
+            this->m_JmdictReadiness = ready.get_future().share();
+            return;
+        }
+        this->m_JmdictReadiness =
+            std::async(std::launch::async, [this, databasesDirectory]() {
+                auto jmdict = parseJmdictData(databasesDirectory);
+                if (!jmdict.empty())
+                    this->m_Vocabulary.appendSegment(
+                        detail::VocabularySegment(jmdict), true);
+            }).share();
+    }
+
+    LogicHandler::~LogicHandler() {
+        // the loader still accesses this handler
+        this->waitForJmdict();
+    }
+
+    bool LogicHandler::isJmdictReady() const {
+        return this->m_JmdictReadiness.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+    }
+
+    void LogicHandler::waitForJmdict() const { this->m_JmdictReadiness.wait(); }
+
+    std::shared_future<void> LogicHandler::getJmdictReadiness() const {
+        return this->m_JmdictReadiness;
     }
 
     QuestionHandler LogicHandler::createQuestionHandler() const {
@@ -357,8 +811,8 @@ namespace shared {
         return this->m_Translator;
     }
 
-    const detail::VocabularyVector& LogicHandler::getAllVocabulary() const {
-        return this->m_AllVocabulary;
+    const detail::VocabularyStore& LogicHandler::getAllVocabulary() const {
+        return this->m_Vocabulary;
     }
 
     VocabularyDeck LogicHandler::createVocabularyDeck() const {
@@ -409,6 +863,49 @@ namespace shared {
         return this->m_CurrentDeck;
     }
 
+    std::shared_ptr<const detail::VocabularyAttributes>
+        LogicHandler::getVocabularyAttributes() const {
+        std::lock_guard<std::mutex> lock(this->m_AttributesMutex);
+        if (!this->m_Attributes ||
+            this->m_Attributes->size() != this->m_Vocabulary.size()) {
+            this->m_Attributes =
+                std::make_shared<detail::VocabularyAttributes>(
+                    this->m_Vocabulary);
+        }
+        return this->m_Attributes;
+    }
+
+    detail::VocabularyVector
+        LogicHandler::suggestVocabularies(detail::Vocabulary::Type level,
+                                          size_t count, bool kanjiOnly) const {
+        const auto attributes = this->getVocabularyAttributes();
+        const auto inDeck =
+            this->m_CurrentDeck->getStoreBitmap(this->m_Vocabulary);
+
+        using Query = detail::VocabularyQuery;
+        auto query = Query(attributes->level(level)) & ~Query(inDeck);
+        if (kanjiOnly)
+            query = query & Query(attributes->hasKanji());
+
+        // reservoir sampling, the matching ids are streamed only once
+        std::vector<detail::VocabularyId> chosen;
+        size_t seen = 0;
+        for (const auto id : query) {
+            if (chosen.size() < count)
+                chosen.push_back(id);
+            else if (const auto idx = detail::util::getRandomIndex(seen + 1);
+                     idx < count)
+                chosen[idx] = id;
+            ++seen;
+        }
+
+        detail::VocabularyVector result;
+        result.reserve(chosen.size());
+        for (const auto id : chosen)
+            result.push_back(this->m_Vocabulary[id].toVocabulary());
+        return result;
+    }
+
     VocabularyDeck::VocabularyDeck(const std::string &userFilePath, const std::wstring &filename)
         : m_UserFilePath(userFilePath)
     {
@@ -419,81 +916,100 @@ namespace shared {
         return this->m_DeckName;
     }
 
-    template <typename FlashcardContainer>
-    decltype(auto) Helper_findFlashcardsByIter(
-        FlashcardContainer& sortedContainer,
-        detail::VocabularyVector::const_iterator citer) {
-        using Fc = VocabularyDeck::Flashcard;
-        return std::equal_range(sortedContainer.begin(), sortedContainer.end(),
-                                Fc{0, citer});
-    }
-
     const detail::VocabularyVector& VocabularyDeck::getAllVocabularies() const {
         return this->m_Vocabulary;
     }
 
+    size_t VocabularyDeck::_vocabularyKey(const detail::Vocabulary& voc) {
+        const std::hash<std::string_view> hash;
+        return hash(voc.kana) * 31 + hash(voc.kanji);
+    }
+
+    void VocabularyDeck::_rebuildVocabularyIds() {
+        this->m_VocabularyIds.clear();
+        this->m_VocabularyIds.reserve(this->m_Vocabulary.size());
+        for (size_t i = 0; i < this->m_Vocabulary.size(); ++i) {
+            this->m_VocabularyIds.emplace(
+                _vocabularyKey(this->m_Vocabulary[i]), detail::VocabularyId(i));
+        }
+    }
+
+    std::optional<detail::VocabularyId>
+        VocabularyDeck::findVocabularyId(const detail::Vocabulary& voc) const {
+        // only vocabulary with the same kana and kanji is compared
+        const auto range =
+            this->m_VocabularyIds.equal_range(_vocabularyKey(voc));
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            if (this->m_Vocabulary[iter->second] == voc)
+                return iter->second;
+        }
+        return std::nullopt;
+    }
+
     std::optional<VocabularyDeck::Flashcard>
-        VocabularyDeck::getFlashcard(unsigned vocIdx) const {
-        if (vocIdx < this->m_Vocabulary.size())
+        VocabularyDeck::getFlashcard(detail::VocabularyId vocId) const {
+        if (vocId >= this->m_CardIndices.size() || !this->m_CardIndices[vocId])
             return std::nullopt;
 
-        return this->getFlashcard(this->m_Vocabulary.cbegin() + vocIdx);
+        return Flashcard{*this->m_CardIndices[vocId], vocId};
     }
 
     std::optional<VocabularyDeck::Flashcard>
         VocabularyDeck::getFlashcard(const detail::Vocabulary& voc) const {
-        const auto citer = std::find(this->m_Vocabulary.cbegin(),
-                                     this->m_Vocabulary.cend(), voc);
-        return this->getFlashcard(citer);
-    }
-
-    std::optional<VocabularyDeck::Flashcard> VocabularyDeck::getFlashcard(
-        detail::VocabularyVector::const_iterator citer) const {
-        const auto range =
-            Helper_findFlashcardsByIter(this->m_SortedFlashcards, citer);
-        return range.first != this->m_SortedFlashcards.end()
-                   ? std::optional{*range.first}
-                   : std::nullopt;
+        const auto vocId = this->findVocabularyId(voc);
+        return vocId ? this->getFlashcard(*vocId) : std::nullopt;
     }
 
-    bool VocabularyDeck::setFlashcardIndex(unsigned vocIdx,
+    bool VocabularyDeck::setFlashcardIndex(detail::VocabularyId vocId,
                                            unsigned newCardIdx) {
-        if (vocIdx < this->m_Vocabulary.size())
+        if (vocId >= this->m_CardIndices.size() || !this->m_CardIndices[vocId])
             return false;
 
-        return this->setFlashcardIndex(this->m_Vocabulary.cbegin() + vocIdx,
-                                       newCardIdx);
+        this->m_CardIndices[vocId] = newCardIdx;
+        return true;
     }
 
     bool VocabularyDeck::setFlashcardIndex(const detail::Vocabulary& voc,
                                            unsigned newCardIdx) {
-        const auto citer = std::find(this->m_Vocabulary.cbegin(),
-                                     this->m_Vocabulary.cend(), voc);
-
-        return this->setFlashcardIndex(citer, newCardIdx);
+        const auto vocId = this->findVocabularyId(voc);
+        return vocId && this->setFlashcardIndex(*vocId, newCardIdx);
     }
 
-    bool VocabularyDeck::setFlashcardIndex(
-        detail::VocabularyVector::const_iterator citer, unsigned newCardIdx) {
-        auto range =
-            Helper_findFlashcardsByIter(this->m_SortedFlashcards, citer);
-
-        if (range.first == this->m_SortedFlashcards.end())
+    bool VocabularyDeck::addFlashcard(const VocabularyDeck::Flashcard& fc) {
+        if (fc.vocId >= this->m_CardIndices.size() ||
+            this->m_CardIndices[fc.vocId]) {
             return false;
-
-        range.first->cardIndex = newCardIdx;
+        }
+        this->m_CardIndices[fc.vocId] = fc.cardIndex;
         return true;
     }
 
-    bool VocabularyDeck::addFlashcard(const VocabularyDeck::Flashcard& fc) {
-        auto& sfc = this->m_SortedFlashcards;
-        auto iter = std::upper_bound(sfc.begin(), sfc.end(), fc);
-        if (iter != sfc.end() && iter->vocIter == fc.vocIter)
-            return false;
+    detail::VocabularyBitmap VocabularyDeck::getStoreBitmap(
+        const detail::VocabularyStore& store) const {
+        return this->getFlashcardBitmap(store, Flashcard::MIN_CARD_INDEX,
+                                        Flashcard::MAX_CARD_INDEX);
+    }
 
-        iter = (iter == sfc.end()) ? sfc.begin() : std::next(iter);
-        this->m_SortedFlashcards.insert(iter, fc);
-        return true;
+    detail::VocabularyBitmap VocabularyDeck::getFlashcardBitmap(
+        const detail::VocabularyStore& store,
+        Flashcard::index_type minCardIndex,
+        Flashcard::index_type maxCardIndex) const {
+        const bool all = minCardIndex == Flashcard::MIN_CARD_INDEX &&
+                         maxCardIndex == Flashcard::MAX_CARD_INDEX;
+
+        detail::VocabularyBitmap result(store.size());
+        for (size_t i = 0; i < this->m_Vocabulary.size(); ++i) {
+            if (!all) {
+                const auto& cardIndex = this->m_CardIndices[i];
+                if (!cardIndex || *cardIndex < minCardIndex ||
+                    *cardIndex > maxCardIndex)
+                    continue;
+            }
+            const auto storeId = store.findId(this->m_Vocabulary[i]);
+            if (storeId && *storeId < result.size())
+                result.set(*storeId);
+        }
+        return result;
     }
 
     shared::VocabularyDeck::operator const detail::VocabularyVector&() const {
@@ -531,40 +1047,66 @@ namespace shared {
     }
 
     void VocabularyDeck::addVocabularyUnique(const detail::Vocabulary& voc) {
-        const auto citer = std::find(this->m_Vocabulary.cbegin(),
-                                     this->m_Vocabulary.cend(), voc);
+        if (this->findVocabularyId(voc))
+            return;
 
-        if (citer == this->m_Vocabulary.cend())
-            this->m_Vocabulary.push_back(voc);
+        const auto vocId = detail::VocabularyId(this->m_Vocabulary.size());
+        this->m_Vocabulary.push_back(voc);
+        this->m_CardIndices.emplace_back();
+        this->m_VocabularyIds.emplace(_vocabularyKey(voc), vocId);
     }
 
-    void VocabularyDeck::clear() { this->m_Vocabulary.clear(); }
+    void VocabularyDeck::clear() {
+        this->m_Vocabulary.clear();
+        this->m_CardIndices.clear();
+        this->m_VocabularyIds.clear();
+    }
 
     bool VocabularyDeck::removeVocabulary(const detail::Vocabulary& voc) {
-        auto iter = std::find(this->m_Vocabulary.begin(),
-                              this->m_Vocabulary.end(), voc);
-
-        if (iter == this->m_Vocabulary.end())
+        const auto vocId = this->findVocabularyId(voc);
+        if (!vocId)
             return false;
 
-        this->m_Vocabulary.erase(iter);
+        // cards move along with their vocabulary,
+        // only the ids behind the removed one change
+        this->m_Vocabulary.erase(this->m_Vocabulary.begin() + *vocId);
+        this->m_CardIndices.erase(this->m_CardIndices.begin() + *vocId);
+        this->_rebuildVocabularyIds();
         return true;
     }
 
     struct VocabularyDeck_SaveLoad_Helper {
 
-        static constexpr const wchar_t VocSplitWChar = L';';
+        static constexpr const char VocSplitChar = ';';
 
-        static std::vector<std::wstring>
-            splitVocDeckString(const std::wstring& wstr) {
-            std::wstringstream wsstr(wstr);
-            std::vector<std::wstring> result;
-            for (std::wstring str; std::getline(wsstr, str, VocSplitWChar);)
-                result.push_back(str);
+        static std::vector<std::string>
+            splitVocDeckString(const std::string& str) {
+            std::stringstream sstr(str);
+            std::vector<std::string> result;
+            for (std::string e; std::getline(sstr, e, VocSplitChar);)
+                result.push_back(e);
 
             return result;
         }
 
+        // the text has to stay alive until the statement is stepped
+        static bool bindText(sqlite3_stmt* stmt, int idx,
+                             std::string_view text) {
+            return sqlite3_bind_text(stmt, idx, text.data(), int(text.size()),
+                                     SQLITE_STATIC) == SQLITE_OK;
+        }
+
+        static bool stepAndReset(sqlite3_stmt* stmt) {
+            const auto res = sqlite3_step(stmt);
+            return sqlite3_reset(stmt) == SQLITE_OK && res == SQLITE_DONE;
+        }
+
+        static bool clearTable(sqlite3* db, std::string_view tableName) {
+            const auto stm = "delete from " + std::string(tableName);
+            return sqlite3_exec(db, stm.c_str(), nullptr, nullptr, nullptr) ==
+                   SQLITE_OK;
+        }
+
         struct VocabularyTable {
             static constexpr const std::string_view TableName = "Vocabulary";
 
@@ -599,37 +1141,39 @@ namespace shared {
                 return result;
             }
 
+            // replaces the content of the table,
+            // expected to run inside a transaction
             static bool writeTable(sqlite3* db,
                                    const detail::VocabularyVector& vocs) {
+                if (!clearTable(db, VocabularyTable::TableName))
+                    return false;
+
                 const std::string sql =
                     "insert into " + std::string(VocabularyTable::TableName) +
                     " (" + std::string(VocabularyTable::English) + ',' +
                     std::string(VocabularyTable::Kana) + ',' +
                     std::string(VocabularyTable::Kanji) + ',' +
-                    std::string(VocabularyTable::Type) + ") values ";
+                    std::string(VocabularyTable::Type) + ") values (?,?,?,?)";
+                detail::util::Sqlite3StatementHelper stmt(db, sql);
+                if (!stmt)
+                    return false;
 
-                bool result = true;
                 for (const auto& e : vocs) {
-                    const auto stm = sql + vocabularyToString(e) + ';';
-                    if (sqlite3_exec(db, stm.c_str(), nullptr, nullptr,
-                                     nullptr) != SQLITE_OK) {
-                        result = false;
+                    const auto english =
+                        detail::util::combineStringContainerToString(
+                            e.english, std::string_view(&VocSplitChar, 1));
+                    if (!bindText(stmt, 1, english) ||
+                        !bindText(stmt, 2, e.kana) ||
+                        !bindText(stmt, 3, e.kanji) ||
+                        sqlite3_bind_int(stmt, 4, int(e.type)) != SQLITE_OK ||
+                        !stepAndReset(stmt)) {
+                        return false;
                     }
                 }
-                return result;
+                return true;
             }
 
           private:
-            static std::string
-                vocabularyToString(const detail::Vocabulary& voc) {
-                const auto convFunc = detail::convertWstringUtf8;
-                return R"((")" +
-                       convFunc(detail::util::combineWStringContainerToWstring(
-                           voc.english)) +
-                       R"(",")" + convFunc(voc.kana) + R"(",")" +
-                       convFunc(voc.kanji) + R"(",")" +
-                       std::to_string(int(voc.type)) + R"("))";
-            }
 
             static int callback(void* vocVec, int argc, char** argv, char**) {
                 assert(argc == 4);
@@ -638,9 +1182,9 @@ namespace shared {
 
                 auto data = static_cast<detail::VocabularyVector*>(vocVec);
 
-                const auto english = detail::convertUtf8Wstring(argv[0]);
-                const auto kana = detail::convertUtf8Wstring(argv[1]);
-                const auto kanji = detail::convertUtf8Wstring(argv[2]);
+                const std::string english = argv[0] ? argv[0] : "";
+                const std::string_view kana = argv[1] ? argv[1] : "";
+                const std::string_view kanji = argv[2] ? argv[2] : "";
                 const auto type = detail::Vocabulary::Type(std::stoi(argv[3]));
 
                 data->emplace_back(kana, splitVocDeckString(english), type,
@@ -681,31 +1225,37 @@ namespace shared {
                 return combineStructVocs(vocs, tableStructs);
             }
 
+            // same as VocabularyTable::writeTable
             static bool
-                writeTable(sqlite3* db,
-                           const std::vector<VocabularyDeck::Flashcard>& vocs) {
-                if (vocs.empty())
-                    return true;
+                writeTable(sqlite3* db, const detail::VocabularyVector& vocs,
+                           const std::vector<VocabularyDeck::Flashcard>& cards) {
+                if (!clearTable(db, FlashcardTable::TableName))
+                    return false;
 
                 const std::string sql =
                     "insert into " + std::string(FlashcardTable::TableName) +
                     '(' + std::string(FlashcardTable::Kana) + ',' +
-                    std::string(FlashcardTable::FlashcardIndex) + ") values ";
-
-                bool result = true;
-                for (const auto& e : vocs) {
-                    const auto stm = sql + flashcardToString(e) + ';';
-                    if (sqlite3_exec(db, stm.c_str(), nullptr, nullptr,
-                                     nullptr) != SQLITE_OK) {
-                        result = false;
+                    std::string(FlashcardTable::FlashcardIndex) +
+                    ") values (?,?)";
+                detail::util::Sqlite3StatementHelper stmt(db, sql);
+                if (!stmt)
+                    return false;
+
+                for (const auto& e : cards) {
+                    if (!bindText(stmt, 1, vocs[e.vocId].kana) ||
+                        sqlite3_bind_int64(stmt, 2, sqlite3_int64(
+                                                        e.cardIndex)) !=
+                            SQLITE_OK ||
+                        !stepAndReset(stmt)) {
+                        return false;
                     }
                 }
-                return result;
+                return true;
             }
 
           private:
             struct TableStruct {
-                std::wstring kana;
+                std::string kana;
                 VocabularyDeck::Flashcard::index_type flashcardIndex = 0;
             };
 
@@ -713,28 +1263,22 @@ namespace shared {
                 const detail::VocabularyVector& vocs,
                 const std::vector<TableStruct>& tableStructs) {
 
+                // first vocabulary wins if several share the same kana
+                std::unordered_map<std::string_view, detail::VocabularyId> ids;
+                ids.reserve(vocs.size());
+                for (size_t i = 0; i < vocs.size(); ++i)
+                    ids.emplace(vocs[i].kana, detail::VocabularyId(i));
+
                 std::vector<VocabularyDeck::Flashcard> result;
                 for (const auto& e : tableStructs) {
-                    auto& card = result.emplace_back();
-                    card.cardIndex = e.flashcardIndex;
-                    card.vocIter =
-                        std::find_if(vocs.cbegin(), vocs.cend(),
-                                     [&e](const detail::Vocabulary& voc) {
-                                         return voc.kana == e.kana;
-                                     });
-                    assert(card.vocIter != vocs.cend());
-                    if (card.vocIter == vocs.cend())
-                        result.pop_back();
+                    const auto iter = ids.find(e.kana);
+                    assert(iter != ids.end());
+                    if (iter != ids.end())
+                        result.push_back({e.flashcardIndex, iter->second});
                 }
                 return result;
             }
 
-            static std::string
-                flashcardToString(const VocabularyDeck::Flashcard& card) {
-                return '(' + detail::convertWstringUtf8(card.vocIter->kana) +
-                       ',' + std::to_string(card.cardIndex) + ')';
-            }
-
             static int callback(void* vec, int argc, char** argv, char**) {
                 assert(argc == 2);
                 if (argc != 2)
@@ -742,8 +1286,10 @@ namespace shared {
 
                 auto data = static_cast<std::vector<TableStruct>*>(vec);
                 auto& card = data->emplace_back();
-                card.kana = detail::convertUtf8Wstring(argv[0]);
-                card.flashcardIndex = std::stoi(argv[1]);
+                card.kana = argv[0] ? argv[0] : "";
+                // card indices may exceed the range of an int
+                card.flashcardIndex =
+                    VocabularyDeck::Flashcard::index_type(std::stoul(argv[1]));
                 return 0;
             };
         };
@@ -768,11 +1314,11 @@ namespace shared {
         }
 
         static bool writeFlashcards(
-            sqlite3* db,
+            sqlite3* db, const detail::VocabularyVector& vocs,
             const std::vector<VocabularyDeck::Flashcard>& flashcards) {
             assert(db);
             FlashcardTable::createTable(db);
-            return FlashcardTable::writeTable(db, flashcards);
+            return FlashcardTable::writeTable(db, vocs, flashcards);
         }
     };
 
@@ -782,12 +1328,23 @@ namespace shared {
         if (!db)
             return false;
 
+        std::vector<Flashcard> flashcards;
+        for (size_t i = 0; i < this->m_CardIndices.size(); ++i) {
+            if (const auto& cardIndex = this->m_CardIndices[i])
+                flashcards.push_back({*cardIndex, detail::VocabularyId(i)});
+        }
+
+        // a deck is written as a whole, one transaction instead of one per row
+        detail::util::Sqlite3TransactionHelper transaction(db);
+        if (!transaction)
+            return false;
+
         using Vdsh = VocabularyDeck_SaveLoad_Helper;
         if (!Vdsh::writeVocabulary(db, this->m_Vocabulary) ||
-            !Vdsh::writeFlashcards(db, this->m_SortedFlashcards)) {
+            !Vdsh::writeFlashcards(db, this->m_Vocabulary, flashcards)) {
             return false;
         }
-        return true;
+        return transaction.commit();
     }
 
     bool VocabularyDeck::_loadFromFile(const std::string &path)
@@ -799,20 +1356,21 @@ namespace shared {
         using Vdsh = VocabularyDeck_SaveLoad_Helper;
         this->m_DeckName = boost::filesystem::path(path).filename().string();
         this->m_Vocabulary = Vdsh::readVocabulary(db);
-        this->m_SortedFlashcards = Vdsh::readFlashcards(this->m_Vocabulary, db);
-        std::sort(this->m_SortedFlashcards.begin(),
-                  this->m_SortedFlashcards.end());
+        this->m_CardIndices.assign(this->m_Vocabulary.size(), std::nullopt);
+        this->_rebuildVocabularyIds();
+        for (const auto& e : Vdsh::readFlashcards(this->m_Vocabulary, db))
+            this->addFlashcard(e);
         return true;
     }
 
     bool VocabularyDeck::Flashcard::operator<(
         const VocabularyDeck::Flashcard& rhs) const {
-        return this->vocIter < rhs.vocIter;
+        return this->vocId < rhs.vocId;
     }
 
     bool VocabularyDeck::Flashcard::operator==(
         const VocabularyDeck::Flashcard& rhs) const {
-        return this->vocIter == rhs.vocIter;
+        return this->vocId == rhs.vocId;
     }
 
 } // namespace shared